@@ -0,0 +1,745 @@
+// MiniGit benchmark suite.
+//
+// Generates a deterministic synthetic repository, runs microbenchmarks against the hashing and
+// commit-parsing code, times the minigit commands end to end on the generated repository and
+// prints the results as JSON so runs can be compared over time.
+//
+// Build from the repository root, against libminigit.a built as described in the README:
+//   g++ -std=c++17 -O2 -pthread bench/minigit_bench.cpp -L. -lminigit -o minigit-bench
+// Run:
+//   ./minigit-bench --minigit=./minigit --scale=1k --output=bench.json
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../digest.h"
+#include "../minigit.h"
+#include "../minigit_internal.h"
+
+namespace fs = std::filesystem;
+
+// The commit-parsing microbenchmarks reach into the library's internals through minigit_internal.h
+using minigit::CommitInfo;
+using minigit::parse_commit;
+using minigit::parse_commit_files;
+
+// Shape of the synthetic repository
+struct BenchConfig
+{
+    std::string scale = "1k";
+    size_t files = 1000;
+    size_t commits = 200;
+    size_t depth = 2;                // Directory levels above each file
+    size_t min_size = 64;            // File sizes are drawn log-uniformly from [min_size, max_size]
+    size_t max_size = 16384;
+    size_t branches = 4;             // Topic branches that commits are spread over
+    double merge_rate = 0.1;         // Fraction of commits on master that merge a topic branch
+    size_t changes_per_commit = 10;  // Files modified by each non-merge commit
+    uint64_t seed = 1;
+    std::string hash = "sha1";       // Object-id algorithm the generated repository is initialized with
+    std::string minigit = "./minigit";
+    std::string directory = "minigit-bench-repo";
+    std::string output;
+    bool micro = true;
+    bool end_to_end = true;
+};
+
+// One measured result, rendered as a JSON object
+struct BenchResult
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> fields; // Key -> already-encoded JSON value
+};
+
+// Deterministic generator; the same seed always produces the same repository
+struct SplitMix64
+{
+    uint64_t state;
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t below(uint64_t bound)
+    {
+        return bound == 0 ? 0 : next() % bound;
+    }
+
+    double unit()
+    {
+        return static_cast<double>(next() >> 11) / static_cast<double>(1ull << 53);
+    }
+};
+
+// Helper function to encode a string as a JSON string literal
+std::string json_string(const std::string& text)
+{
+    std::string encoded = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            encoded += '\\';
+            encoded += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            encoded += escape;
+        }
+        else
+        {
+            encoded += c;
+        }
+    }
+    return encoded + "\"";
+}
+
+// Helper function to encode a number as a JSON value
+template <typename Number>
+std::string json_number(Number value)
+{
+    std::ostringstream out;
+    out << std::setprecision(6) << value;
+    return out.str();
+}
+
+// Helper function to measure the wall-clock seconds fn takes
+template <typename Fn>
+double time_seconds(Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Helper function to run the minigit binary inside the benchmark repository, discarding its output
+bool run_minigit(const BenchConfig& config, const std::vector<std::string>& args)
+{
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(config.minigit.c_str()));
+    for (const std::string& arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        int null_fd = ::open("/dev/null", O_WRONLY);
+        ::dup2(null_fd, STDOUT_FILENO);
+        if (::chdir(config.directory.c_str()) != 0)
+        {
+            ::_exit(127);
+        }
+        ::execv(argv[0], argv.data());
+        ::_exit(127);
+    }
+    int status = 0;
+    if (child < 0 || ::waitpid(child, &status, 0) < 0)
+    {
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Helper function to place file number `index` in a directory tree `depth` levels deep
+std::string synthetic_path(const BenchConfig& config, size_t index)
+{
+    // About 32 files per leaf directory, with the same fan-out on every level above
+    const size_t files_per_directory = 32;
+    size_t leaves = std::max<size_t>(1, (config.files + files_per_directory - 1) / files_per_directory);
+    size_t fanout = config.depth == 0 ? 1 : static_cast<size_t>(std::ceil(std::pow(static_cast<double>(leaves), 1.0 / config.depth)));
+    size_t leaf = index / files_per_directory;
+    std::string path;
+    for (size_t level = 0; level < config.depth; level++)
+    {
+        path += "d" + std::to_string(leaf % fanout) + "/";
+        leaf /= fanout;
+    }
+    return path + "f" + std::to_string(index) + ".txt";
+}
+
+// Helper function to generate text content; the line structure gives diff something to work on
+std::string synthetic_content(const BenchConfig& config, SplitMix64& rng)
+{
+    static const char* words[] = {"alpha", "beta", "gamma", "delta", "commit", "branch", "merge", "object",
+                                  "index", "tree", "blob", "ref", "head", "chunk", "graph", "pack"};
+    double log_min = std::log(static_cast<double>(config.min_size));
+    double log_max = std::log(static_cast<double>(std::max(config.min_size, config.max_size)));
+    size_t size = static_cast<size_t>(std::exp(log_min + (log_max - log_min) * rng.unit()));
+    std::string content;
+    content.reserve(size + 16);
+    while (content.size() < size)
+    {
+        content += words[rng.below(16)];
+        content += rng.below(8) == 0 ? '\n' : ' ';
+    }
+    content.resize(size);
+    content += '\n';
+    return content;
+}
+
+// Summary of what the generator produced
+struct RepositoryStats
+{
+    size_t commits = 0;
+    size_t merges = 0;
+    size_t blobs = 0;
+    uint64_t bytes = 0;
+};
+
+// Writes the synthetic history as an import stream.
+//
+// The first commit adds every file on master. Each later commit goes to master or one of the topic
+// branches (created from master on first use) and rewrites `changes_per_commit` files; commits on
+// master merge a topic branch with probability `merge_rate`, taking over the files it changed.
+// The stream ends with a "bench-topic" branch touching odd-numbered files and a master commit
+// touching even-numbered ones, so the end-to-end merge is conflict-free.
+RepositoryStats write_import_stream(const BenchConfig& config, std::ostream& out)
+{
+    SplitMix64 rng{config.seed};
+    RepositoryStats stats;
+    size_t next_mark = 1;
+    std::time_t commit_time = 1700000000;
+
+    auto emit_blob = [&](const std::string& content) -> std::string {
+        std::string mark = ":" + std::to_string(next_mark++);
+        out << "blob\nmark " << mark << "\ndata " << content.size() << "\n" << content << "\n";
+        stats.blobs++;
+        stats.bytes += content.size();
+        return mark;
+    };
+    auto emit_commit = [&](const std::string& branch, const std::vector<std::string>& parents,
+                           const std::vector<std::pair<std::string, std::string>>& changes, const std::string& message) {
+        std::string mark = ":" + std::to_string(next_mark++);
+        out << "commit refs/heads/" << branch << "\nmark " << mark << "\n";
+        out << "committer Bench <bench@example.com> " << commit_time++ << " +0000\n";
+        out << "data " << message.size() << "\n" << message << "\n";
+        for (size_t p = 0; p < parents.size(); p++)
+        {
+            out << (p == 0 ? "from " : "merge ") << parents[p] << "\n";
+        }
+        for (const auto& [blob_mark, path] : changes)
+        {
+            out << "M " << blob_mark << " " << path << "\n";
+        }
+        out << "\n";
+        stats.commits++;
+        stats.merges += parents.size() > 1;
+        return mark;
+    };
+    auto modify_files = [&](size_t count, size_t parity) {
+        std::vector<std::pair<std::string, std::string>> changes;
+        for (size_t c = 0; c < count; c++)
+        {
+            size_t index = rng.below(config.files);
+            if (parity != 2)
+            {
+                index = std::min(config.files - 1, (index & ~static_cast<size_t>(1)) | parity);
+            }
+            std::string content = synthetic_content(config, rng);
+            changes.push_back({emit_blob(content), synthetic_path(config, index)});
+        }
+        return changes;
+    };
+
+    // Initial snapshot: every file on master
+    std::vector<std::pair<std::string, std::string>> initial;
+    for (size_t index = 0; index < config.files; index++)
+    {
+        std::string content = synthetic_content(config, rng);
+        initial.push_back({emit_blob(content), synthetic_path(config, index)});
+    }
+    std::string master_tip = emit_commit("master", {}, initial, "Initial snapshot");
+    initial.clear();
+
+    struct TopicBranch
+    {
+        std::string tip;
+        std::vector<std::pair<std::string, std::string>> changed; // Changes not yet merged into master
+    };
+    std::vector<TopicBranch> topics(config.branches);
+
+    for (size_t n = 1; n < config.commits; n++)
+    {
+        size_t target = rng.below(config.branches + 1);
+        if (target == config.branches)
+        {
+            std::vector<size_t> mergeable;
+            for (size_t t = 0; t < topics.size(); t++)
+            {
+                if (!topics[t].changed.empty())
+                {
+                    mergeable.push_back(t);
+                }
+            }
+            if (!mergeable.empty() && rng.unit() < config.merge_rate)
+            {
+                TopicBranch& topic = topics[mergeable[rng.below(mergeable.size())]];
+                master_tip = emit_commit("master", {master_tip, topic.tip}, topic.changed, "Merge topic");
+                topic.changed.clear();
+                topic.tip.clear();
+                continue;
+            }
+            master_tip = emit_commit("master", {master_tip}, modify_files(config.changes_per_commit, 2),
+                                     "Change " + std::to_string(n));
+            continue;
+        }
+
+        // Topic branches fork from master's current tip whenever they have nothing unmerged
+        TopicBranch& topic = topics[target];
+        std::string parent = topic.tip.empty() ? master_tip : topic.tip;
+        auto changes = modify_files(config.changes_per_commit, 2);
+        topic.changed.insert(topic.changed.end(), changes.begin(), changes.end());
+        topic.tip = emit_commit("b" + std::to_string(target), {parent}, changes, "Topic change " + std::to_string(n));
+    }
+
+    emit_commit("bench-topic", {master_tip}, modify_files(config.changes_per_commit, 1), "Topic for merge benchmark");
+    emit_commit("master", {master_tip}, modify_files(config.changes_per_commit, 0), "Master before merge benchmark");
+    return stats;
+}
+
+// Microbenchmark: digest throughput of one hash algorithm for one input size
+BenchResult bench_hash(const hashing::Algorithm& algorithm, size_t input_size)
+{
+    std::vector<uint8_t> input(input_size);
+    SplitMix64 rng{42};
+    for (uint8_t& byte : input)
+    {
+        byte = static_cast<uint8_t>(rng.next());
+    }
+
+    // Repeat until at least half a second has passed so small inputs are not dominated by timer noise
+    size_t iterations = 0;
+    double seconds = 0;
+    while (seconds < 0.5)
+    {
+        size_t round = std::max<size_t>(1, (64u << 20) / std::max<size_t>(input_size, 64) / 8);
+        seconds += time_seconds([&]() {
+            for (size_t i = 0; i < round; i++)
+            {
+                uint8_t digest[hashing::kMaxDigestSize];
+                algorithm.digest(input.data(), input.size(), digest);
+            }
+        });
+        iterations += round;
+    }
+    double bytes = static_cast<double>(iterations) * static_cast<double>(input_size);
+    return {std::string(algorithm.name) + ".digest/" + std::to_string(input_size),
+            {{"input_bytes", json_number(input_size)},
+             {"iterations", json_number(iterations)},
+             {"seconds", json_number(seconds)},
+             {"mb_per_s", json_number(bytes / (1024.0 * 1024.0) / seconds)},
+             {"ns_per_hash", json_number(seconds * 1e9 / static_cast<double>(iterations))}}};
+}
+
+// Microbenchmark: parsing every commit object of the generated repository from memory
+std::vector<BenchResult> bench_commit_parsing(const BenchConfig& config)
+{
+    std::vector<std::string> commits;
+    for (const auto& entry : fs::directory_iterator(config.directory + "/.minigit/objects"))
+    {
+        std::ifstream object_file(entry.path(), std::ios::binary);
+        // Commit objects start with the "tree " placeholder line
+        char prefix[6] = {};
+        if (object_file.read(prefix, 6) && std::string(prefix, 6) == "tree \n")
+        {
+            object_file.seekg(0);
+            commits.emplace_back((std::istreambuf_iterator<char>(object_file)), std::istreambuf_iterator<char>());
+        }
+    }
+
+    size_t parents = 0;
+    double header_seconds = time_seconds([&]() {
+        for (const std::string& content : commits)
+        {
+            CommitInfo info;
+            parse_commit(content, info);
+            parents += info.parents.size();
+        }
+    });
+    size_t file_entries = 0;
+    double files_seconds = time_seconds([&]() {
+        for (const std::string& content : commits)
+        {
+            file_entries += parse_commit_files(content).size();
+        }
+    });
+
+    double count = static_cast<double>(std::max<size_t>(1, commits.size()));
+    return {{"commit.parse_headers",
+             {{"commits", json_number(commits.size())},
+              {"parents", json_number(parents)},
+              {"seconds", json_number(header_seconds)},
+              {"us_per_commit", json_number(header_seconds * 1e6 / count)}}},
+            {"commit.parse_files",
+             {{"commits", json_number(commits.size())},
+              {"file_entries", json_number(file_entries)},
+              {"seconds", json_number(files_seconds)},
+              {"us_per_commit", json_number(files_seconds * 1e6 / count)}}}};
+}
+
+// In-process timings through the library API, showing what the caches kept by a Repository handle save
+// across calls and how read operations scale when several threads share one handle
+std::vector<BenchResult> bench_library(const BenchConfig& config)
+{
+    std::string error;
+    std::unique_ptr<minigit::Repository> repository = minigit::Repository::open(config.directory, {}, error);
+    if (!repository)
+    {
+        std::cerr << error;
+        return {};
+    }
+
+    size_t commits = 0;
+    double cold_seconds = time_seconds([&]() { commits = repository->log().commits.size(); });
+    double warm_seconds = time_seconds([&]() { commits = repository->log().commits.size(); });
+
+    // Each thread walks the history limited to a different path
+    std::vector<std::string> paths;
+    for (size_t t = 0; t < 8; t++)
+    {
+        paths.push_back(synthetic_path(config, t * config.files / 8));
+    }
+    auto path_logs = [&](size_t first, size_t step) {
+        for (size_t t = first; t < paths.size(); t += step)
+        {
+            minigit::LogOptions options;
+            options.paths = {paths[t]};
+            repository->log(options);
+        }
+    };
+    double serial_seconds = time_seconds([&]() { path_logs(0, 1); });
+    size_t threads = std::min<size_t>(paths.size(), std::max(1u, std::thread::hardware_concurrency()));
+    double parallel_seconds = time_seconds([&]() {
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++)
+        {
+            workers.emplace_back(path_logs, t, threads);
+        }
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    });
+
+    return {{"library.log",
+             {{"commits", json_number(commits)},
+              {"cold_seconds", json_number(cold_seconds)},
+              {"warm_seconds", json_number(warm_seconds)}}},
+            {"library.path_log",
+             {{"paths", json_number(paths.size())},
+              {"threads", json_number(threads)},
+              {"serial_seconds", json_number(serial_seconds)},
+              {"parallel_seconds", json_number(parallel_seconds)}}}};
+}
+
+// Helper function to record one end-to-end command timing
+BenchResult timed_command(const BenchConfig& config, const std::string& name, const std::vector<std::vector<std::string>>& invocations)
+{
+    bool ok = true;
+    double seconds = time_seconds([&]() {
+        for (const auto& args : invocations)
+        {
+            ok = run_minigit(config, args) && ok;
+        }
+    });
+    std::cerr << "  " << name << ": " << std::fixed << std::setprecision(3) << seconds << " s" << (ok ? "" : " (failed)") << std::endl;
+    return {name, {{"seconds", json_number(seconds)}, {"invocations", json_number(invocations.size())}, {"ok", ok ? "true" : "false"}}};
+}
+
+// End-to-end timings of the minigit commands on the generated repository
+std::vector<BenchResult> bench_end_to_end(const BenchConfig& config, const std::string& stream_path)
+{
+    std::vector<BenchResult> results;
+    results.push_back(timed_command(config, "import", {{"import", fs::absolute(stream_path).string()}}));
+    results.push_back(timed_command(config, "checkout", {{"checkout", "master"}}));
+    results.push_back(timed_command(config, "status", {{"status"}}));
+    results.push_back(timed_command(config, "log", {{"log"}}));
+
+    // Rewrite 1% of the even-numbered files, which bench-topic never touches, and stage them in
+    // batches that stay well below the argument length limit
+    SplitMix64 rng{config.seed ^ 0x5EED};
+    size_t touched = std::max<size_t>(1, config.files / 100);
+    std::set<std::string> paths;
+    for (size_t t = 0; t < touched; t++)
+    {
+        size_t index = std::min(config.files - 1, rng.below(config.files) & ~static_cast<size_t>(1));
+        std::string path = synthetic_path(config, index);
+        std::ofstream(config.directory + "/" + path, std::ios::binary) << synthetic_content(config, rng);
+        paths.insert(path);
+    }
+    std::vector<std::vector<std::string>> add_invocations;
+    for (const std::string& path : paths)
+    {
+        if (add_invocations.empty() || add_invocations.back().size() > 2048)
+        {
+            add_invocations.push_back({"add"});
+        }
+        add_invocations.back().push_back(path);
+    }
+    results.push_back(timed_command(config, "add", add_invocations));
+    results.back().fields.push_back({"files", json_number(paths.size())});
+    results.push_back(timed_command(config, "commit", {{"commit", "-m", "Benchmark commit"}}));
+    results.push_back(timed_command(config, "merge", {{"merge", "bench-topic"}}));
+
+    // diff compares two generated files of about 10k lines that differ in every 100th line
+    std::string diff_a = "minigit-bench-diff-a.txt";
+    std::string diff_b = "minigit-bench-diff-b.txt";
+    {
+        std::ofstream a(config.directory + "/" + diff_a);
+        std::ofstream b(config.directory + "/" + diff_b);
+        SplitMix64 diff_rng{config.seed};
+        for (size_t line = 0; line < 10000; line++)
+        {
+            std::string text = "line " + std::to_string(line) + " " + std::to_string(diff_rng.next());
+            a << text << "\n";
+            b << (line % 100 == 0 ? text + " changed" : text) << "\n";
+        }
+    }
+    results.push_back(timed_command(config, "diff", {{"diff", diff_a, diff_b}}));
+    fs::remove(config.directory + "/" + diff_a);
+    fs::remove(config.directory + "/" + diff_b);
+    return results;
+}
+
+// Helper function to render a list of results as a JSON array
+std::string json_results(const std::vector<BenchResult>& results)
+{
+    std::string json = "[";
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        json += (r == 0 ? "\n    {" : ",\n    {") + std::string("\"name\": ") + json_string(results[r].name);
+        for (const auto& [key, value] : results[r].fields)
+        {
+            json += ", " + json_string(key) + ": " + value;
+        }
+        json += "}";
+    }
+    return json + (results.empty() ? "]" : "\n  ]");
+}
+
+// Helper function to apply the 1k/100k/1m presets before explicit options override them
+void apply_scale(BenchConfig& config, const std::string& scale)
+{
+    config.scale = scale;
+    if (scale == "100k")
+    {
+        config.files = 100000;
+        config.commits = 1000;
+        config.depth = 3;
+        config.max_size = 8192;
+    }
+    else if (scale == "1m")
+    {
+        config.files = 1000000;
+        config.commits = 2000;
+        config.depth = 4;
+        config.max_size = 4096;
+    }
+    else
+    {
+        config.scale = "1k";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--scale=", 0) == 0)
+        {
+            apply_scale(config, arg.substr(8));
+        }
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        std::string key = arg.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        if (key == "--scale")
+        {
+            continue;
+        }
+        else if (key == "--files")
+        {
+            config.files = std::max<size_t>(2, std::stoull(value));
+        }
+        else if (key == "--commits")
+        {
+            config.commits = std::max<size_t>(1, std::stoull(value));
+        }
+        else if (key == "--depth")
+        {
+            config.depth = std::stoull(value);
+        }
+        else if (key == "--min-size")
+        {
+            config.min_size = std::max<size_t>(1, std::stoull(value));
+        }
+        else if (key == "--max-size")
+        {
+            config.max_size = std::stoull(value);
+        }
+        else if (key == "--branches")
+        {
+            config.branches = std::stoull(value);
+        }
+        else if (key == "--merge-rate")
+        {
+            config.merge_rate = std::stod(value);
+        }
+        else if (key == "--changes")
+        {
+            config.changes_per_commit = std::max<size_t>(1, std::stoull(value));
+        }
+        else if (key == "--seed")
+        {
+            config.seed = std::stoull(value);
+        }
+        else if (key == "--hash" && hashing::find_algorithm(value) != nullptr)
+        {
+            config.hash = value;
+        }
+        else if (key == "--minigit")
+        {
+            config.minigit = value;
+        }
+        else if (key == "--dir")
+        {
+            config.directory = value;
+        }
+        else if (key == "--output")
+        {
+            config.output = value;
+        }
+        else if (key == "--no-micro")
+        {
+            config.micro = false;
+        }
+        else if (key == "--no-end-to-end")
+        {
+            config.end_to_end = false;
+        }
+        else
+        {
+            std::cerr << "Usage: minigit-bench [--scale=1k|100k|1m] [--files=N] [--commits=N] [--depth=N]\n"
+                      << "                     [--min-size=BYTES] [--max-size=BYTES] [--branches=N] [--merge-rate=P]\n"
+                      << "                     [--changes=N] [--seed=N] [--hash=" << hashing::algorithm_names() << "]\n"
+                      << "                     [--minigit=PATH] [--dir=PATH] [--output=FILE]\n"
+                      << "                     [--no-micro] [--no-end-to-end]\n";
+            return 1;
+        }
+    }
+    config.minigit = fs::absolute(config.minigit).string();
+    if (config.end_to_end && !fs::exists(config.minigit))
+    {
+        std::cerr << "Error: minigit binary not found at " << config.minigit << " (use --minigit=PATH)" << std::endl;
+        return 1;
+    }
+
+    std::vector<BenchResult> micro_results;
+    if (config.micro)
+    {
+        std::cerr << "Running hash microbenchmarks" << std::endl;
+        for (const char* name : {"sha1", "sha256", "blake3"})
+        {
+            for (size_t input_size : {64u, 4096u, 1u << 20})
+            {
+                micro_results.push_back(bench_hash(*hashing::find_algorithm(name), input_size));
+            }
+        }
+    }
+
+    // Generate the repository from scratch so every run measures the same history
+    std::cerr << "Generating " << config.files << " files and " << config.commits << " commits in " << config.directory << std::endl;
+    fs::remove_all(config.directory);
+    fs::create_directories(config.directory);
+    std::string stream_path = config.directory + "/minigit-bench.import";
+    RepositoryStats stats;
+    double generate_seconds = time_seconds([&]() {
+        std::ofstream stream(stream_path, std::ios::binary);
+        stats = write_import_stream(config, stream);
+    });
+
+    std::vector<BenchResult> end_to_end_results;
+    if (config.end_to_end)
+    {
+        std::cerr << "Running end-to-end benchmarks" << std::endl;
+        run_minigit(config, {"init", "--hash=" + config.hash});
+        end_to_end_results = bench_end_to_end(config, stream_path);
+        if (config.micro)
+        {
+            std::cerr << "Running commit parsing microbenchmarks" << std::endl;
+            for (BenchResult& result : bench_commit_parsing(config))
+            {
+                micro_results.push_back(std::move(result));
+            }
+            std::cerr << "Running library benchmarks" << std::endl;
+            for (BenchResult& result : bench_library(config))
+            {
+                micro_results.push_back(std::move(result));
+            }
+        }
+    }
+    fs::remove(stream_path);
+
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"suite\": \"minigit-bench\",\n"
+         << "  \"timestamp\": " << json_string(timestamp) << ",\n"
+         << "  \"config\": {\"scale\": " << json_string(config.scale)
+         << ", \"files\": " << config.files << ", \"commits\": " << config.commits
+         << ", \"depth\": " << config.depth << ", \"min_size\": " << config.min_size
+         << ", \"max_size\": " << config.max_size << ", \"branches\": " << config.branches
+         << ", \"merge_rate\": " << json_number(config.merge_rate)
+         << ", \"changes_per_commit\": " << config.changes_per_commit << ", \"seed\": " << config.seed
+         << ", \"hash\": " << json_string(config.hash) << "},\n"
+         << "  \"repository\": {\"commits\": " << stats.commits << ", \"merges\": " << stats.merges
+         << ", \"blobs\": " << stats.blobs << ", \"bytes\": " << stats.bytes
+         << ", \"generate_seconds\": " << json_number(generate_seconds) << "},\n"
+         << "  \"micro\": " << json_results(micro_results) << ",\n"
+         << "  \"end_to_end\": " << json_results(end_to_end_results) << "\n"
+         << "}\n";
+
+    if (config.output.empty())
+    {
+        std::cout << json.str();
+    }
+    else
+    {
+        std::ofstream(config.output) << json.str();
+        std::cerr << "Results written to " << config.output << std::endl;
+    }
+    return 0;
+}
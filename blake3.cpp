@@ -0,0 +1,475 @@
+#include "blake3.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MINIGIT_BLAKE3_X86 1
+#endif
+
+namespace hashing::blake3 {
+
+namespace {
+
+constexpr size_t kBlockLen = 64;
+constexpr size_t kChunkLen = 1024;
+constexpr size_t kBlocksPerChunk = kChunkLen / kBlockLen;
+
+// Subtrees of up to this many whole chunks are hashed level by level, each
+// level in SIMD batches.
+constexpr size_t kWideChunks = 64;
+
+// Subtrees at least this large hand their left half to another thread while
+// spare hardware threads remain.
+constexpr uint64_t kParallelMinBytes = 512 * 1024;
+
+enum : uint8_t {
+  CHUNK_START = 1 << 0,
+  CHUNK_END = 1 << 1,
+  PARENT = 1 << 2,
+  ROOT = 1 << 3,
+};
+
+const uint32_t IV[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                        0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+// Message word order for each of the seven rounds.
+const uint8_t kSchedule[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+inline uint32_t rotr(uint32_t w, int c) { return (w >> c) | (w << (32 - c)); }
+
+inline uint32_t load32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline void store_cv(const uint32_t cv[8], uint8_t* out) {
+  for (int i = 0; i < 8; i++) {
+    out[i * 4] = static_cast<uint8_t>(cv[i]);
+    out[i * 4 + 1] = static_cast<uint8_t>(cv[i] >> 8);
+    out[i * 4 + 2] = static_cast<uint8_t>(cv[i] >> 16);
+    out[i * 4 + 3] = static_cast<uint8_t>(cv[i] >> 24);
+  }
+}
+
+inline void g(uint32_t* v, int a, int b, int c, int d, uint32_t x, uint32_t y) {
+  v[a] = v[a] + v[b] + x;
+  v[d] = rotr(v[d] ^ v[a], 16);
+  v[c] = v[c] + v[d];
+  v[b] = rotr(v[b] ^ v[c], 12);
+  v[a] = v[a] + v[b] + y;
+  v[d] = rotr(v[d] ^ v[a], 8);
+  v[c] = v[c] + v[d];
+  v[b] = rotr(v[b] ^ v[c], 7);
+}
+
+// The compression function, keeping only the chaining value it produces. The
+// output may alias the input chaining value.
+void compress(const uint32_t cv[8], const uint8_t* block, uint32_t block_len,
+              uint64_t counter, uint8_t flags, uint32_t out[8]) {
+  uint32_t m[16];
+  for (int i = 0; i < 16; i++) {
+    m[i] = load32(block + i * 4);
+  }
+  uint32_t v[16] = {cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                    IV[0], IV[1], IV[2], IV[3],
+                    static_cast<uint32_t>(counter),
+                    static_cast<uint32_t>(counter >> 32), block_len, flags};
+  for (const uint8_t* s : kSchedule) {
+    g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+  }
+  for (int i = 0; i < 8; i++) {
+    out[i] = v[i] ^ v[i + 8];
+  }
+}
+
+// Hashes one input of whole blocks: a full chunk, or a parent node's two
+// child chaining values.
+void hash_one(const uint8_t* input, size_t blocks, uint64_t counter, uint8_t flags,
+              uint8_t flags_start, uint8_t flags_end, uint8_t* out) {
+  uint32_t cv[8];
+  std::memcpy(cv, IV, sizeof(cv));
+  uint8_t block_flags = flags | flags_start;
+  for (size_t b = 0; b < blocks; b++) {
+    if (b + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    compress(cv, input + b * kBlockLen, kBlockLen, counter, block_flags, cv);
+    block_flags = flags;
+  }
+  store_cv(cv, out);
+}
+
+#ifdef MINIGIT_BLAKE3_X86
+
+// The SIMD kernels below run the same compressions for 4 or 8 inputs at once,
+// one input per lane: v[i] holds state word i of every lane, so the message
+// blocks are transposed on the way in and the chaining values on the way out.
+
+template <int C>
+inline __m128i rotr_128(__m128i x) {
+  return _mm_or_si128(_mm_srli_epi32(x, C), _mm_slli_epi32(x, 32 - C));
+}
+
+inline void g_128(__m128i* v, int a, int b, int c, int d, __m128i x, __m128i y) {
+  v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), x);
+  v[d] = _mm_xor_si128(v[d], v[a]);
+  v[d] = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v[d], 0xB1), 0xB1);
+  v[c] = _mm_add_epi32(v[c], v[d]);
+  v[b] = rotr_128<12>(_mm_xor_si128(v[b], v[c]));
+  v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), y);
+  v[d] = rotr_128<8>(_mm_xor_si128(v[d], v[a]));
+  v[c] = _mm_add_epi32(v[c], v[d]);
+  v[b] = rotr_128<7>(_mm_xor_si128(v[b], v[c]));
+}
+
+inline void transpose_128(__m128i* rows) {
+  __m128i ab01 = _mm_unpacklo_epi32(rows[0], rows[1]);
+  __m128i ab23 = _mm_unpackhi_epi32(rows[0], rows[1]);
+  __m128i cd01 = _mm_unpacklo_epi32(rows[2], rows[3]);
+  __m128i cd23 = _mm_unpackhi_epi32(rows[2], rows[3]);
+  rows[0] = _mm_unpacklo_epi64(ab01, cd01);
+  rows[1] = _mm_unpackhi_epi64(ab01, cd01);
+  rows[2] = _mm_unpacklo_epi64(ab23, cd23);
+  rows[3] = _mm_unpackhi_epi64(ab23, cd23);
+}
+
+void hash4_sse2(const uint8_t* const* inputs, size_t blocks, uint64_t counter,
+                bool increment_counter, uint8_t flags, uint8_t flags_start,
+                uint8_t flags_end, uint8_t* out) {
+  __m128i h[8];
+  for (int i = 0; i < 8; i++) {
+    h[i] = _mm_set1_epi32(static_cast<int>(IV[i]));
+  }
+  uint64_t counters[4];
+  for (int lane = 0; lane < 4; lane++) {
+    counters[lane] = counter + (increment_counter ? lane : 0);
+  }
+  const __m128i counter_low = _mm_setr_epi32(
+      static_cast<int>(counters[0]), static_cast<int>(counters[1]),
+      static_cast<int>(counters[2]), static_cast<int>(counters[3]));
+  const __m128i counter_high = _mm_setr_epi32(
+      static_cast<int>(counters[0] >> 32), static_cast<int>(counters[1] >> 32),
+      static_cast<int>(counters[2] >> 32), static_cast<int>(counters[3] >> 32));
+
+  uint8_t block_flags = flags | flags_start;
+  for (size_t b = 0; b < blocks; b++) {
+    if (b + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    __m128i m[16];
+    for (int quarter = 0; quarter < 4; quarter++) {
+      for (int lane = 0; lane < 4; lane++) {
+        m[quarter * 4 + lane] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            inputs[lane] + b * kBlockLen + quarter * 16));
+      }
+      transpose_128(m + quarter * 4);
+    }
+    __m128i v[16] = {h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                     _mm_set1_epi32(static_cast<int>(IV[0])),
+                     _mm_set1_epi32(static_cast<int>(IV[1])),
+                     _mm_set1_epi32(static_cast<int>(IV[2])),
+                     _mm_set1_epi32(static_cast<int>(IV[3])),
+                     counter_low, counter_high,
+                     _mm_set1_epi32(static_cast<int>(kBlockLen)),
+                     _mm_set1_epi32(block_flags)};
+    for (const uint8_t* s : kSchedule) {
+      g_128(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+      g_128(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+      g_128(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+      g_128(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+      g_128(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+      g_128(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+      g_128(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+      g_128(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++) {
+      h[i] = _mm_xor_si128(v[i], v[i + 8]);
+    }
+    block_flags = flags;
+  }
+
+  transpose_128(h);
+  transpose_128(h + 4);
+  for (int lane = 0; lane < 4; lane++) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + lane * 32), h[lane]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + lane * 32 + 16), h[lane + 4]);
+  }
+}
+
+#define MINIGIT_AVX2 __attribute__((target("avx2")))
+
+template <int C>
+MINIGIT_AVX2 inline __m256i rotr_256(__m256i x) {
+  return _mm256_or_si256(_mm256_srli_epi32(x, C), _mm256_slli_epi32(x, 32 - C));
+}
+
+MINIGIT_AVX2 inline void g_256(__m256i* v, int a, int b, int c, int d, __m256i x,
+                               __m256i y) {
+  // Rotations by whole bytes are a single byte shuffle.
+  const __m256i rot16 = _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+  const __m256i rot8 = _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+                                       12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1);
+  v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), x);
+  v[d] = _mm256_shuffle_epi8(_mm256_xor_si256(v[d], v[a]), rot16);
+  v[c] = _mm256_add_epi32(v[c], v[d]);
+  v[b] = rotr_256<12>(_mm256_xor_si256(v[b], v[c]));
+  v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), y);
+  v[d] = _mm256_shuffle_epi8(_mm256_xor_si256(v[d], v[a]), rot8);
+  v[c] = _mm256_add_epi32(v[c], v[d]);
+  v[b] = rotr_256<7>(_mm256_xor_si256(v[b], v[c]));
+}
+
+MINIGIT_AVX2 inline void transpose_256(__m256i* rows) {
+  __m256i pairs[8];
+  for (int i = 0; i < 8; i += 2) {
+    pairs[i] = _mm256_unpacklo_epi32(rows[i], rows[i + 1]);
+    pairs[i + 1] = _mm256_unpackhi_epi32(rows[i], rows[i + 1]);
+  }
+  // Within each 128-bit half, quads[k] and quads[4 + k] now hold word k of
+  // rows 0-3 and rows 4-7 respectively.
+  __m256i quads[8];
+  for (int i = 0; i < 8; i += 4) {
+    quads[i] = _mm256_unpacklo_epi64(pairs[i], pairs[i + 2]);
+    quads[i + 1] = _mm256_unpackhi_epi64(pairs[i], pairs[i + 2]);
+    quads[i + 2] = _mm256_unpacklo_epi64(pairs[i + 1], pairs[i + 3]);
+    quads[i + 3] = _mm256_unpackhi_epi64(pairs[i + 1], pairs[i + 3]);
+  }
+  for (int k = 0; k < 4; k++) {
+    rows[k] = _mm256_permute2x128_si256(quads[k], quads[k + 4], 0x20);
+    rows[k + 4] = _mm256_permute2x128_si256(quads[k], quads[k + 4], 0x31);
+  }
+}
+
+MINIGIT_AVX2 void hash8_avx2(const uint8_t* const* inputs, size_t blocks,
+                             uint64_t counter, bool increment_counter, uint8_t flags,
+                             uint8_t flags_start, uint8_t flags_end, uint8_t* out) {
+  __m256i h[8];
+  for (int i = 0; i < 8; i++) {
+    h[i] = _mm256_set1_epi32(static_cast<int>(IV[i]));
+  }
+  alignas(32) uint32_t counter_words[2][8];
+  for (int lane = 0; lane < 8; lane++) {
+    uint64_t lane_counter = counter + (increment_counter ? lane : 0);
+    counter_words[0][lane] = static_cast<uint32_t>(lane_counter);
+    counter_words[1][lane] = static_cast<uint32_t>(lane_counter >> 32);
+  }
+  const __m256i counter_low =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(counter_words[0]));
+  const __m256i counter_high =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(counter_words[1]));
+
+  uint8_t block_flags = flags | flags_start;
+  for (size_t b = 0; b < blocks; b++) {
+    if (b + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    __m256i m[16];
+    for (int half = 0; half < 2; half++) {
+      for (int lane = 0; lane < 8; lane++) {
+        m[half * 8 + lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+            inputs[lane] + b * kBlockLen + half * 32));
+      }
+      transpose_256(m + half * 8);
+    }
+    __m256i v[16] = {h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                     _mm256_set1_epi32(static_cast<int>(IV[0])),
+                     _mm256_set1_epi32(static_cast<int>(IV[1])),
+                     _mm256_set1_epi32(static_cast<int>(IV[2])),
+                     _mm256_set1_epi32(static_cast<int>(IV[3])),
+                     counter_low, counter_high,
+                     _mm256_set1_epi32(static_cast<int>(kBlockLen)),
+                     _mm256_set1_epi32(block_flags)};
+    for (const uint8_t* s : kSchedule) {
+      g_256(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+      g_256(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+      g_256(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+      g_256(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+      g_256(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+      g_256(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+      g_256(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+      g_256(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++) {
+      h[i] = _mm256_xor_si256(v[i], v[i + 8]);
+    }
+    block_flags = flags;
+  }
+
+  transpose_256(h);
+  for (int lane = 0; lane < 8; lane++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + lane * 32), h[lane]);
+  }
+}
+
+#endif  // MINIGIT_BLAKE3_X86
+
+// Hashes count inputs of the same number of whole blocks, writing one 32-byte
+// chaining value per input to out. Chunk counters advance by one per input when
+// increment_counter is set.
+void hash_many(const uint8_t* const* inputs, size_t count, size_t blocks,
+               uint64_t counter, bool increment_counter, uint8_t flags,
+               uint8_t flags_start, uint8_t flags_end, uint8_t* out) {
+#ifdef MINIGIT_BLAKE3_X86
+  static const bool use_avx2 = __builtin_cpu_supports("avx2");
+  while (use_avx2 && count >= 8) {
+    hash8_avx2(inputs, blocks, counter, increment_counter, flags, flags_start,
+               flags_end, out);
+    inputs += 8;
+    count -= 8;
+    out += 8 * 32;
+    counter += increment_counter ? 8 : 0;
+  }
+  while (count >= 4) {
+    hash4_sse2(inputs, blocks, counter, increment_counter, flags, flags_start,
+               flags_end, out);
+    inputs += 4;
+    count -= 4;
+    out += 4 * 32;
+    counter += increment_counter ? 4 : 0;
+  }
+#endif
+  for (; count > 0; count--) {
+    hash_one(*inputs++, blocks, counter, flags, flags_start, flags_end, out);
+    out += 32;
+    counter += increment_counter ? 1 : 0;
+  }
+}
+
+// Hashes a chunk of at most kChunkLen bytes, the last block zero-padded.
+// root_flag is ROOT when the chunk is the whole input.
+void hash_chunk(const uint8_t* input, size_t len, uint64_t chunk_counter,
+                uint8_t root_flag, uint8_t* out) {
+  uint32_t cv[8];
+  std::memcpy(cv, IV, sizeof(cv));
+  size_t blocks = std::max<size_t>(1, (len + kBlockLen - 1) / kBlockLen);
+  for (size_t b = 0; b < blocks; b++) {
+    size_t block_len = std::min(kBlockLen, len - b * kBlockLen);
+    uint8_t block[kBlockLen] = {};
+    std::memcpy(block, input + b * kBlockLen, block_len);
+    uint8_t flags = (b == 0 ? CHUNK_START : 0) |
+                    (b + 1 == blocks ? CHUNK_END | root_flag : 0);
+    compress(cv, block, static_cast<uint32_t>(block_len), chunk_counter, flags, cv);
+  }
+  store_cv(cv, out);
+}
+
+void hash_parent(const uint8_t* children, uint8_t flags, uint8_t* out) {
+  uint32_t cv[8];
+  compress(IV, children, kBlockLen, 0, PARENT | flags, cv);
+  store_cv(cv, out);
+}
+
+// Hardware threads not yet busy with a subtree.
+std::atomic<int> spare_threads{
+    static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1};
+
+bool reserve_thread() {
+  int spare = spare_threads.load();
+  while (spare > 0) {
+    if (spare_threads.compare_exchange_weak(spare, spare - 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void hash_subtree(const uint8_t* input, uint64_t len, uint64_t chunk_counter,
+                  uint8_t* out);
+
+// Fills children with the chaining values of the two subtrees under a node
+// covering more than one chunk. The left subtree is the largest power-of-two
+// number of chunks that leaves at least one byte for the right.
+void hash_children(const uint8_t* input, uint64_t len, uint64_t chunk_counter,
+                   uint8_t* children) {
+  uint64_t full_chunks = (len - 1) / kChunkLen;
+  uint64_t left_chunks = 1;
+  while (left_chunks * 2 <= full_chunks) {
+    left_chunks *= 2;
+  }
+  uint64_t left_len = left_chunks * kChunkLen;
+
+  if (len >= kParallelMinBytes && reserve_thread()) {
+    std::thread left([&] {
+      hash_subtree(input, left_len, chunk_counter, children);
+      spare_threads++;
+    });
+    hash_subtree(input + left_len, len - left_len, chunk_counter + left_chunks,
+                 children + 32);
+    left.join();
+    return;
+  }
+  hash_subtree(input, left_len, chunk_counter, children);
+  hash_subtree(input + left_len, len - left_len, chunk_counter + left_chunks,
+               children + 32);
+}
+
+// Computes the (non-root) chaining value of the subtree over input.
+void hash_subtree(const uint8_t* input, uint64_t len, uint64_t chunk_counter,
+                  uint8_t* out) {
+  if (len <= kChunkLen) {
+    hash_chunk(input, len, chunk_counter, 0, out);
+    return;
+  }
+
+  uint64_t chunks = len / kChunkLen;
+  if (len % kChunkLen == 0 && chunks <= kWideChunks && (chunks & (chunks - 1)) == 0) {
+    // A complete small subtree: every chunk, then every parent level, goes
+    // through hash_many so the SIMD lanes stay full.
+    const uint8_t* inputs[kWideChunks];
+    uint8_t level[2][kWideChunks * 32];
+    for (uint64_t i = 0; i < chunks; i++) {
+      inputs[i] = input + i * kChunkLen;
+    }
+    hash_many(inputs, chunks, kBlocksPerChunk, chunk_counter, true, 0, CHUNK_START,
+              CHUNK_END, level[0]);
+    int current = 0;
+    for (; chunks > 1; chunks /= 2) {
+      for (uint64_t i = 0; i < chunks / 2; i++) {
+        inputs[i] = level[current] + i * 64;
+      }
+      hash_many(inputs, chunks / 2, 1, 0, false, PARENT, 0, 0, level[1 - current]);
+      current = 1 - current;
+    }
+    std::memcpy(out, level[current], 32);
+    return;
+  }
+
+  uint8_t children[64];
+  hash_children(input, len, chunk_counter, children);
+  hash_parent(children, 0, out);
+}
+
+}  // namespace
+
+void digest(const void* input_bs, uint64_t input_size, uint8_t* out) {
+  const auto* input = static_cast<const uint8_t*>(input_bs);
+  if (input_size <= kChunkLen) {
+    hash_chunk(input, input_size, 0, ROOT, out);
+    return;
+  }
+  uint8_t children[64];
+  hash_children(input, input_size, 0, children);
+  hash_parent(children, ROOT, out);
+}
+
+}  // namespace hashing::blake3
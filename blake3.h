@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hashing::blake3 {
+
+// Writes the 32-byte BLAKE3 digest of a bytestring to out.
+//
+// Whole 1 KiB chunks are compressed several at a time across SIMD lanes (SSE2,
+// or AVX2 when the CPU has it), and large inputs split their hash tree across
+// threads, so hashing big blobs scales with the machine.
+void digest(const void* input_bs, uint64_t input_size, uint8_t* out);
+
+}  // namespace hashing::blake3
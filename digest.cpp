@@ -0,0 +1,50 @@
+#include "digest.h"
+
+#include "blake3.h"
+#include "sha1.h"
+#include "sha256.h"
+
+namespace hashing {
+
+namespace {
+
+const Algorithm kAlgorithms[] = {
+    {"sha1", 20, sha1::digest},
+    {"sha256", 32, sha256::digest},
+    {"blake3", 32, blake3::digest},
+};
+
+}  // namespace
+
+const Algorithm* find_algorithm(const std::string& name) {
+  for (const Algorithm& algorithm : kAlgorithms) {
+    if (name == algorithm.name) {
+      return &algorithm;
+    }
+  }
+  return nullptr;
+}
+
+std::string algorithm_names() {
+  std::string names;
+  for (const Algorithm& algorithm : kAlgorithms) {
+    names += std::string(names.empty() ? "" : "|") + algorithm.name;
+  }
+  return names;
+}
+
+std::string hex_digest(const Algorithm& algorithm, const void* input_bs,
+                       uint64_t input_size) {
+  const char hexChars[] = "0123456789abcdef";
+  uint8_t sig[kMaxDigestSize];
+  algorithm.digest(input_bs, input_size, sig);
+  std::string hex;
+  hex.reserve(algorithm.digest_size * 2);
+  for (std::size_t i = 0; i < algorithm.digest_size; i++) {
+    hex.push_back(hexChars[(sig[i] >> 4) & 0xF]);
+    hex.push_back(hexChars[sig[i] & 0xF]);
+  }
+  return hex;
+}
+
+}  // namespace hashing
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace hashing {
+
+// One object-id hash function. A repository picks its algorithm at init time
+// and names every object by the hex digest of the object's content under it.
+struct Algorithm {
+  const char* name;
+  std::size_t digest_size;  // In bytes; object ids are twice as many hex chars.
+  void (*digest)(const void* input_bs, uint64_t input_size, uint8_t* out);
+};
+
+// Largest digest_size of any supported algorithm.
+constexpr std::size_t kMaxDigestSize = 32;
+
+// Looks up an algorithm by name ("sha1", "sha256", "blake3"); nullptr if unknown.
+const Algorithm* find_algorithm(const std::string& name);
+
+// The supported names joined with '|', for usage messages.
+std::string algorithm_names();
+
+// Hashes the bytestring and returns the digest as lowercase hex.
+std::string hex_digest(const Algorithm& algorithm, const void* input_bs,
+                       uint64_t input_size);
+
+}  // namespace hashing
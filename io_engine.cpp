@@ -0,0 +1,533 @@
+#include "io_engine.h"
+
+#include <unistd.h>
+
+// The io_uring backend needs Linux headers recent enough to describe the
+// opcode probe (5.6); everywhere else only the thread pool is built.
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(IO_URING_OP_SUPPORTED) && defined(__NR_io_uring_setup)
+#define MINIGIT_IO_URING 1
+#endif
+#endif
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace io {
+namespace {
+
+constexpr unsigned kQueueDepth = 128;    // Requests kept in flight per ring.
+constexpr size_t kSlotSize = 32 * 1024;  // Registered buffer owned by each in-flight request.
+
+enum class Engine { kUnset, kAuto, kUring, kThreads };
+std::atomic<Engine> requested_engine{Engine::kAuto};
+thread_local Engine thread_engine = Engine::kUnset;  // Set by ScopedEngine.
+
+Engine parse_engine(const std::string& name) {
+  return name == "uring"     ? Engine::kUring
+         : name == "threads" ? Engine::kThreads
+                             : Engine::kAuto;
+}
+
+// Reads and writes share one pipeline: open, transfer the data in slot-sized
+// pieces, optionally fsync, close.
+struct Job {
+  const char* path;
+  int open_flags;
+  mode_t mode;
+  const char* data;   // Source buffer for writes, nullptr for reads.
+  uint64_t size;      // Bytes to write.
+  bool sync;
+  std::string* out;   // Destination for reads.
+  bool* ok;
+};
+
+// Runs one job with ordinary blocking system calls.
+void run_job_blocking(Job& job) {
+  int fd = ::open(job.path, job.open_flags | O_CLOEXEC, job.mode);
+  if (fd < 0) {
+    return;
+  }
+  bool ok = true;
+  if (job.data != nullptr) {
+    uint64_t done = 0;
+    while (ok && done < job.size) {
+      ssize_t result = ::write(fd, job.data + done, job.size - done);
+      ok = result > 0;
+      done += ok ? static_cast<uint64_t>(result) : 0;
+    }
+    ok = ok && (!job.sync || ::fsync(fd) == 0);
+  } else {
+    char buffer[kSlotSize];
+    job.out->clear();
+    for (;;) {
+      ssize_t result = ::read(fd, buffer, sizeof(buffer));
+      if (result <= 0) {
+        ok = result == 0;
+        break;
+      }
+      job.out->append(buffer, static_cast<size_t>(result));
+    }
+  }
+  ok = ::close(fd) == 0 && ok;
+  *job.ok = ok;
+}
+
+// Thread-pool engine. Blocked threads leave their core idle, so there are more
+// threads than cores.
+void run_threads(std::vector<Job>& jobs, size_t first) {
+  size_t count = jobs.size() - first;
+  size_t thread_count = std::min<size_t>(
+      count, std::max(4u, 2 * std::thread::hardware_concurrency()));
+  if (thread_count <= 1) {
+    for (size_t i = first; i < jobs.size(); i++) {
+      run_job_blocking(jobs[i]);
+    }
+    return;
+  }
+  std::atomic<size_t> next_job{first};
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < thread_count; t++) {
+    workers.emplace_back([&]() {
+      for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+        run_job_blocking(jobs[i]);
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+#ifdef MINIGIT_IO_URING
+
+// A submission/completion ring set up with the raw io_uring system calls.
+class Ring {
+ public:
+  ~Ring() {
+    if (sqes_ != nullptr) {
+      ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+      ::munmap(cq_ptr_, cq_size_);
+    }
+    if (sq_ptr_ != nullptr) {
+      ::munmap(sq_ptr_, sq_size_);
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  bool init(unsigned entries) {
+    io_uring_params params{};
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      return false;
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sq_ptr_ = map(sq_size_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == nullptr) {
+      return false;
+    }
+    cq_ptr_ = single_mmap ? sq_ptr_ : map(cq_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+    if (cq_ptr_ == nullptr || sqes_ == nullptr) {
+      return false;
+    }
+
+    auto* sq = static_cast<char*>(sq_ptr_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    auto* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  // True when the kernel implements every operation the pipeline issues.
+  bool supports_pipeline() const {
+    const uint8_t needed[] = {IORING_OP_OPENAT, IORING_OP_READ_FIXED,
+                              IORING_OP_WRITE_FIXED, IORING_OP_READ,
+                              IORING_OP_WRITE, IORING_OP_FSYNC,
+                              IORING_OP_CLOSE};
+    size_t probe_size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::unique_ptr<char[]> storage(new char[probe_size]());
+    auto* probe = reinterpret_cast<io_uring_probe*>(storage.get());
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, 256) < 0) {
+      return false;
+    }
+    for (uint8_t op : needed) {
+      if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool register_buffers(const iovec* buffers, unsigned count) {
+    return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                     buffers, count) == 0;
+  }
+
+  // Returns a zeroed submission entry; it is handed to the kernel on the next
+  // submit_and_wait().
+  io_uring_sqe* next_sqe() {
+    unsigned tail = local_tail_++;
+    unsigned index = tail & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    return sqe;
+  }
+
+  bool submit_and_wait() {
+    __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+    unsigned to_submit = local_tail_ - submitted_tail_;
+    for (;;) {
+      long result = ::syscall(__NR_io_uring_enter, fd_, to_submit, 1,
+                              IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (result >= 0) {
+        submitted_tail_ += static_cast<unsigned>(result);
+        return true;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        return false;
+      }
+    }
+  }
+
+  // Waits for at least one completion without submitting anything.
+  bool wait() {
+    for (;;) {
+      if (::syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                    nullptr, 0) >= 0) {
+        return true;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        return false;
+      }
+    }
+  }
+
+  // Requests the kernel accepted whose completions have not been reaped.
+  unsigned outstanding() const { return submitted_tail_ - reaped_; }
+
+  template <typename Handler>
+  void reap(Handler&& handler) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      uint64_t user_data = cqe.user_data;
+      int result = cqe.res;
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+      reaped_++;
+      handler(user_data, result);
+    }
+  }
+
+ private:
+  void* map(size_t size, off_t offset) {
+    void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  int fd_ = -1;
+  void* sq_ptr_ = nullptr;
+  void* cq_ptr_ = nullptr;
+  size_t sq_size_ = 0;
+  size_t cq_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  unsigned local_tail_ = 0;
+  unsigned submitted_tail_ = 0;
+  unsigned reaped_ = 0;
+};
+
+bool uring_available() {
+  static const bool available = []() {
+    Ring ring;
+    return ring.init(4) && ring.supports_pipeline();
+  }();
+  return available;
+}
+
+// Per in-flight request state. Each slot has at most one operation queued, so
+// the submission queue never overflows.
+struct Slot {
+  enum Stage { kOpen, kTransfer, kSync, kClose };
+  size_t job = 0;
+  int fd = -1;
+  uint64_t offset = 0;
+  Stage stage = kOpen;
+  bool failed = false;
+};
+
+// io_uring engine: a single thread keeps up to kQueueDepth opens, reads,
+// writes and closes in flight, each request reusing its own registered buffer.
+void run_uring(std::vector<Job>& jobs) {
+  unsigned depth = static_cast<unsigned>(std::min<size_t>(kQueueDepth, jobs.size()));
+  Ring ring;
+  if (!ring.init(depth)) {
+    run_threads(jobs, 0);
+    return;
+  }
+
+  std::unique_ptr<char[]> buffers(new char[depth * kSlotSize]);
+  std::vector<iovec> iovecs(depth);
+  for (unsigned s = 0; s < depth; s++) {
+    iovecs[s].iov_base = buffers.get() + s * kSlotSize;
+    iovecs[s].iov_len = kSlotSize;
+  }
+  // Registration pins the buffers so the kernel skips mapping them on every
+  // request; plain reads and writes are used when the memlock limit refuses.
+  bool fixed = ring.register_buffers(iovecs.data(), depth);
+
+  std::vector<Slot> slots(depth);
+  std::vector<unsigned> free_slots;
+  for (unsigned s = depth; s-- > 0;) {
+    free_slots.push_back(s);
+  }
+  size_t next_job = 0;
+
+  auto queue_open = [&](unsigned s) {
+    const Job& job = jobs[slots[s].job];
+    io_uring_sqe* sqe = ring.next_sqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(job.path);
+    sqe->len = job.mode;
+    sqe->open_flags = static_cast<uint32_t>(job.open_flags | O_CLOEXEC);
+    sqe->user_data = s;
+  };
+  auto queue_simple = [&](unsigned s, uint8_t opcode, Slot::Stage stage) {
+    io_uring_sqe* sqe = ring.next_sqe();
+    sqe->opcode = opcode;
+    sqe->fd = slots[s].fd;
+    sqe->user_data = s;
+    slots[s].stage = stage;
+  };
+  auto queue_transfer = [&](unsigned s) {
+    Slot& slot = slots[s];
+    const Job& job = jobs[slot.job];
+    bool writing = job.data != nullptr;
+    uint64_t length = kSlotSize;
+    if (writing) {
+      length = std::min<uint64_t>(kSlotSize, job.size - slot.offset);
+      if (length == 0) {
+        queue_simple(s, job.sync ? IORING_OP_FSYNC : IORING_OP_CLOSE,
+                     job.sync ? Slot::kSync : Slot::kClose);
+        return;
+      }
+      std::memcpy(iovecs[s].iov_base, job.data + slot.offset, length);
+    }
+    io_uring_sqe* sqe = ring.next_sqe();
+    if (fixed) {
+      sqe->opcode = writing ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+      sqe->buf_index = static_cast<uint16_t>(s);
+    } else {
+      sqe->opcode = writing ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = slot.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iovecs[s].iov_base);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->off = slot.offset;
+    sqe->user_data = s;
+    slot.stage = Slot::kTransfer;
+  };
+
+  auto complete = [&](uint64_t user_data, int result) {
+    unsigned s = static_cast<unsigned>(user_data);
+    Slot& slot = slots[s];
+    const Job& job = jobs[slot.job];
+    switch (slot.stage) {
+      case Slot::kOpen:
+        if (result < 0) {
+          free_slots.push_back(s);
+          return;
+        }
+        slot.fd = result;
+        if (job.data == nullptr) {
+          job.out->clear();
+        }
+        queue_transfer(s);
+        return;
+      case Slot::kTransfer:
+        if (result < 0 || (result == 0 && job.data != nullptr)) {
+          slot.failed = true;
+          queue_simple(s, IORING_OP_CLOSE, Slot::kClose);
+          return;
+        }
+        // Only an empty read marks the end of the file: FUSE, NFS and older
+        // kernels may return a short read before it, like read(2) does.
+        if (result == 0) {
+          queue_simple(s, IORING_OP_CLOSE, Slot::kClose);
+          return;
+        }
+        slot.offset += static_cast<uint64_t>(result);
+        if (job.data == nullptr) {
+          job.out->append(static_cast<char*>(iovecs[s].iov_base), static_cast<size_t>(result));
+        }
+        queue_transfer(s);
+        return;
+      case Slot::kSync:
+        slot.failed = slot.failed || result < 0;
+        queue_simple(s, IORING_OP_CLOSE, Slot::kClose);
+        return;
+      case Slot::kClose:
+        *job.ok = !slot.failed && result >= 0;
+        free_slots.push_back(s);
+        return;
+    }
+  };
+
+  size_t in_flight = 0;
+  for (;;) {
+    while (!free_slots.empty() && next_job < jobs.size()) {
+      unsigned s = free_slots.back();
+      free_slots.pop_back();
+      slots[s] = Slot();
+      slots[s].job = next_job++;
+      queue_open(s);
+    }
+    in_flight = depth - free_slots.size();
+    if (in_flight == 0) {
+      return;
+    }
+    if (!ring.submit_and_wait()) {
+      // The ring is unusable. Requests the kernel already accepted are waited
+      // for, so no descriptor they open is left behind, without queueing
+      // their next steps; requests that finished keep their result.
+      auto settle = [&](uint64_t user_data, int result) {
+        unsigned s = static_cast<unsigned>(user_data);
+        Slot& slot = slots[s];
+        if (slot.stage == Slot::kOpen && result >= 0) {
+          slot.fd = result;
+        } else if (slot.stage == Slot::kClose) {
+          *jobs[slot.job].ok = !slot.failed && result >= 0;
+          slot.fd = -1;
+          free_slots.push_back(s);
+        }
+      };
+      ring.reap(settle);
+      while (ring.outstanding() > 0 && ring.wait()) {
+        ring.reap(settle);
+      }
+      // Unfinished requests close what they opened and start over on the
+      // thread pool, together with the jobs that never reached the ring.
+      std::vector<bool> idle(depth);
+      for (unsigned s : free_slots) {
+        idle[s] = true;
+      }
+      std::vector<Job> retry;
+      for (unsigned s = 0; s < depth; s++) {
+        if (!idle[s]) {
+          if (slots[s].fd >= 0) {
+            ::close(slots[s].fd);
+          }
+          retry.push_back(jobs[slots[s].job]);
+        }
+      }
+      retry.insert(retry.end(),
+                   jobs.begin() + static_cast<std::ptrdiff_t>(next_job),
+                   jobs.end());
+      run_threads(retry, 0);
+      return;
+    }
+    ring.reap(complete);
+  }
+}
+
+#else
+
+bool uring_available() { return false; }
+
+void run_uring(std::vector<Job>& jobs) { run_threads(jobs, 0); }
+
+#endif  // MINIGIT_IO_URING
+
+void run(std::vector<Job>& jobs) {
+  if (jobs.empty()) {
+    return;
+  }
+  // Setting up a ring costs more than a couple of blocking calls
+  if (jobs.size() <= 2 || std::string(engine_name()) != "io_uring") {
+    run_threads(jobs, 0);
+  } else {
+    run_uring(jobs);
+  }
+}
+
+}  // namespace
+
+void set_engine(const std::string& name) { requested_engine = parse_engine(name); }
+
+ScopedEngine::ScopedEngine(const std::string& name)
+    : previous_(static_cast<int>(thread_engine)) {
+  thread_engine = parse_engine(name);
+}
+
+ScopedEngine::~ScopedEngine() { thread_engine = static_cast<Engine>(previous_); }
+
+const char* engine_name() {
+  Engine engine = thread_engine != Engine::kUnset ? thread_engine
+                                                  : requested_engine.load();
+  if (engine != Engine::kThreads && uring_available()) {
+    return "io_uring";
+  }
+  return "threads";
+}
+
+void read_files(std::vector<ReadRequest>& requests) {
+  std::vector<Job> jobs;
+  jobs.reserve(requests.size());
+  for (ReadRequest& request : requests) {
+    request.ok = false;
+    jobs.push_back({request.path.c_str(), O_RDONLY, 0, nullptr, 0, false,
+                    &request.data, &request.ok});
+  }
+  run(jobs);
+}
+
+void write_files(std::vector<WriteRequest>& requests) {
+  std::vector<Job> jobs;
+  jobs.reserve(requests.size());
+  for (WriteRequest& request : requests) {
+    request.ok = false;
+    jobs.push_back({request.path.c_str(), request.open_flags, request.mode,
+                    request.data != nullptr ? request.data : "", request.size,
+                    request.sync, nullptr, &request.ok});
+  }
+  run(jobs);
+}
+
+}  // namespace io
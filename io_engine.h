@@ -0,0 +1,59 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace io {
+
+// One file to be read in full.
+struct ReadRequest {
+  std::string path;
+  std::string data;  // The file's content once the request has completed.
+  bool ok = false;
+};
+
+// One buffer to be written to a file. The data must stay alive until the
+// batch completes.
+struct WriteRequest {
+  std::string path;
+  const char* data = nullptr;
+  uint64_t size = 0;
+  int open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+  mode_t mode = 0644;
+  bool sync = false;  // fsync the file before closing it.
+  bool ok = false;
+};
+
+// Selects the process-wide engine: "uring", "threads", or "auto" (io_uring
+// when it was built in and the kernel supports it, the thread pool
+// otherwise).
+void set_engine(const std::string& name);
+
+// Selects the engine for batches issued by the calling thread while it is in
+// scope, overriding set_engine. Lets each repository handle in a process
+// follow its own core.io setting.
+class ScopedEngine {
+ public:
+  explicit ScopedEngine(const std::string& name);
+  ~ScopedEngine();
+  ScopedEngine(const ScopedEngine&) = delete;
+  ScopedEngine& operator=(const ScopedEngine&) = delete;
+
+ private:
+  int previous_;
+};
+
+// The engine batches actually run on: "io_uring" or "threads".
+const char* engine_name();
+
+// Reads every file in the batch. Requests that fail keep ok == false.
+void read_files(std::vector<ReadRequest>& requests);
+
+// Writes every buffer in the batch. Requests that fail keep ok == false.
+void write_files(std::vector<WriteRequest>& requests);
+
+}  // namespace io
@@ -1,3 +1,6 @@
+#include "minigit.h"
+#include "minigit_internal.h"
+
 #include <iostream>
 #include <string>
 #include <filesystem>
@@ -7,851 +10,4363 @@
 #include <ctime>
 #include <iomanip>
 #include <map>
+#include <set>
 #include <sstream>
-#include "sha1.h"
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <list>
+#include <shared_mutex>
+#include <optional>
+#include <exception>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "digest.h"
+#include "io_engine.h"
+#include "trace.h"
 
 namespace fs = std::filesystem;
 
-// Function to compute SHA-1 hash of a file
-std::string calculate_file_sha1(const std::string& filepath)
+namespace minigit
 {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file.is_open())
-    {
-        std::cerr << "Error: Could not open file " << filepath << std::endl;
-        return "";
-    }
-
-    // Read file content into a vector of chars
-    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    file.close();
 
-    // Convert vector<char> to string for hashing
-    std::string file_content(buffer.begin(), buffer.end());
+// Objects written in batch durability mode keep a temporary name until flush_object_writes() has synced
+// them and renamed them into place, so reads within the same process look them up here first
+struct PendingObjectWrites
+{
+    std::mutex mutex;
+    std::atomic<size_t> count{0};
+    std::unordered_map<std::string, std::string> temp_paths; // Object id -> temporary file
+    bool directory_dirty = false;                            // Renames not yet made durable
+    bool failed = false;                                     // An object of the running operation was not stored
+};
 
-    void* hash_result = hashing::sha1::hash(file_content);
-    std::string sha1_hex = hashing::sha1::sig2hex(hash_result);
-    delete[] static_cast<uint8_t*>(hash_result); // Free the allocated memory
+// Commit metadata cached in .minigit/info/commit-graph so history walks need not open commit objects
+struct CommitGraphEntry
+{
+    std::time_t timestamp = 0;
+    std::vector<std::string> parents;
+    std::string changed_paths;  // Bloom filter bits of paths changed against the first parent
+    bool all_paths = false;     // Too many changes to filter; every path query answers "maybe"
+};
 
-    return sha1_hex;
-}
+// Sparse checkout patterns from .minigit/info/sparse-checkout compiled into a trie of path components.
+// A pattern names a file or directory ("services/api", "docs/", "tools/*"); a leading '!' excludes it.
+// The most specific pattern on a path decides, and paths no pattern covers are excluded.
+struct SparseTrieNode
+{
+    std::map<std::string, std::unique_ptr<SparseTrieNode>> children;
+    int rule = 0;                 // 1 include, -1 exclude, 0 no pattern ends here
+    bool include_below = false;   // Some descendant pattern includes paths
+};
 
-// Helper function to get files from a commit
-std::map<std::string, std::string> get_files_from_commit(const std::string& commit_hash)
+struct SparseCheckout
 {
-    std::map<std::string, std::string> files;
-    std::string commit_content_path = ".minigit/objects/" + commit_hash;
-    std::ifstream commit_file(commit_content_path);
-    std::string line;
+    bool enabled = false;
+    size_t pattern_count = 0;
+    SparseTrieNode root;
 
-    bool in_files_section = false;
-    while (std::getline(commit_file, line))
+    void add_pattern(std::string pattern)
     {
-        if (line.rfind("tree ", 0) == 0 || line.rfind("parent ", 0) == 0 || line.rfind("author ", 0) == 0 || line.rfind("committer ", 0) == 0)
+        int rule = 1;
+        if (!pattern.empty() && pattern[0] == '!')
         {
-            continue;
+            rule = -1;
+            pattern.erase(0, 1);
         }
-        if (line.empty())
+        for (const std::string suffix : {"/**", "/*", "/"})
         {
-            in_files_section = true;
-            continue;
+            if (pattern.size() >= suffix.size() && pattern.compare(pattern.size() - suffix.size(), suffix.size(), suffix) == 0)
+            {
+                pattern.erase(pattern.size() - suffix.size());
+                break;
+            }
+        }
+        while (!pattern.empty() && pattern[0] == '/')
+        {
+            pattern.erase(0, 1);
         }
-        if (in_files_section)
+        if (pattern == "*" || pattern == "**")
         {
-            size_t first_space = line.find(" ");
-            if (first_space != std::string::npos)
+            pattern.clear();
+        }
+
+        SparseTrieNode* node = &root;
+        std::stringstream components(pattern);
+        std::string component;
+        while (std::getline(components, component, '/'))
+        {
+            if (component.empty())
+            {
+                continue;
+            }
+            node->include_below |= rule == 1;
+            std::unique_ptr<SparseTrieNode>& child = node->children[component];
+            if (!child)
             {
-                std::string file_sha1 = line.substr(0, first_space);
-                std::string filename = line.substr(first_space + 1);
-                files[filename] = file_sha1;
+                child = std::make_unique<SparseTrieNode>();
             }
+            node = child.get();
         }
+        node->rule = rule;
+        pattern_count++;
     }
-    commit_file.close();
-    return files;
-}
 
-// Helper function to find common ancestor
-std::string find_common_ancestor(const std::string& commit1_hash, const std::string& commit2_hash)
-{
-    std::vector<std::string> path1;
-    std::string current_commit = commit1_hash;
-    while (!current_commit.empty())
+    // Decides a path by walking its components. When the deciding node excludes a subtree with no
+    // include patterns beneath it, skip_prefix receives that directory so callers can jump past it.
+    bool includes(const std::string& path, std::string* skip_prefix = nullptr) const
     {
-        path1.push_back(current_commit);
-        std::string commit_path = ".minigit/objects/" + current_commit;
-        std::ifstream commit_file(commit_path);
-        std::string line;
-        std::string parent_line;
-        while (std::getline(commit_file, line))
+        if (!enabled)
+        {
+            return true;
+        }
+        const SparseTrieNode* node = &root;
+        int decision = root.rule;
+        size_t start = 0;
+        while (start <= path.size())
         {
-            if (line.rfind("parent ", 0) == 0)
+            size_t slash = path.find('/', start);
+            size_t end = slash == std::string::npos ? path.size() : slash;
+            auto it = node->children.find(path.substr(start, end - start));
+            if (it == node->children.end())
+            {
+                break;
+            }
+            node = it->second.get();
+            if (node->rule != 0)
+            {
+                decision = node->rule;
+            }
+            if (decision != 1 && !node->include_below && slash != std::string::npos)
+            {
+                if (skip_prefix)
+                {
+                    *skip_prefix = path.substr(0, end);
+                }
+                return false;
+            }
+            if (slash == std::string::npos)
             {
-                parent_line = line;
                 break;
             }
+            start = slash + 1;
         }
-        commit_file.close();
-        if (!parent_line.empty())
+        return decision == 1;
+    }
+
+    // Keeps only the included entries of a sorted file list, skipping whole excluded subtrees at once
+    std::map<std::string, std::string> filter(const std::map<std::string, std::string>& files) const
+    {
+        if (!enabled)
         {
-            current_commit = parent_line.substr(7);
+            return files;
         }
-        else
+        std::map<std::string, std::string> included;
+        for (auto it = files.begin(); it != files.end();)
         {
-            current_commit = "";
+            std::string skip_prefix;
+            if (includes(it->first, &skip_prefix))
+            {
+                included.insert(*it);
+                ++it;
+            }
+            else if (!skip_prefix.empty())
+            {
+                // Every "<prefix>/..." entry sorts before "<prefix>0" because '0' follows '/'
+                it = files.lower_bound(skip_prefix + "0");
+            }
+            else
+            {
+                ++it;
+            }
         }
+        return included;
     }
+};
+
+const hashing::Algorithm& repository_hash();
+std::string repo_path(const std::string& path);
+
+// In-memory answer to "is object X stored?", built from a single listing of .minigit/objects once a handle
+// has made enough existence checks to pay for it (see object_exists).
+// Ids are kept as raw bytes in one sorted array with a fan-out table on the first byte, fronted by a
+// Bloom filter so that most absent objects are rejected without a search. Objects written later through
+// the same handle are added to the Bloom filter and a small side set.
+struct ObjectExistenceIndex
+{
+    static const size_t BLOOM_HASHES = 7;
+
+    const size_t id_bytes = repository_hash().digest_size;
+    std::vector<uint8_t> sorted_ids;       // id_bytes per entry
+    std::array<uint32_t, 257> fanout{};    // Entries [fanout[b], fanout[b + 1]) start with byte b
+    std::vector<std::atomic<uint64_t>> bloom;
+    std::unordered_set<std::string> recent; // Raw ids written since the index was built
+    std::mutex recent_mutex;
 
-    std::string common_ancestor = "";
-    current_commit = commit2_hash;
-    while (!current_commit.empty())
+    // Helper to convert a hex object name to raw bytes; false for anything that is not an object id
+    static bool parse_id(const std::string& hex, std::string& raw)
     {
-        for (const std::string& c : path1)
+        size_t id_bytes = repository_hash().digest_size;
+        if (hex.size() != id_bytes * 2)
         {
-            if (c == current_commit)
-            {
-                common_ancestor = c;
-                return common_ancestor;
-            }
+            return false;
         }
-        std::string commit_path = ".minigit/objects/" + current_commit;
-        std::ifstream commit_file(commit_path);
-        std::string line;
-        std::string parent_line;
-        while (std::getline(commit_file, line))
+        raw.resize(id_bytes);
+        for (size_t i = 0; i < id_bytes; i++)
         {
-            if (line.rfind("parent ", 0) == 0)
+            int value = 0;
+            for (size_t j = 0; j < 2; j++)
             {
-                parent_line = line;
-                break;
+                char c = hex[i * 2 + j];
+                int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+                if (digit < 0)
+                {
+                    return false;
+                }
+                value = value * 16 + digit;
             }
+            raw[i] = static_cast<char>(value);
         }
-        commit_file.close();
-        if (!parent_line.empty())
+        return true;
+    }
+
+    // Object ids are already uniformly distributed, so their bytes serve directly as Bloom hashes
+    void bloom_positions(const std::string& raw, uint64_t (&positions)[BLOOM_HASHES]) const
+    {
+        uint64_t h1 = 0, h2 = 0;
+        std::memcpy(&h1, raw.data(), 8);
+        std::memcpy(&h2, raw.data() + 8, 8);
+        h2 |= 1;
+        uint64_t bit_count = bloom.size() * 64;
+        for (size_t i = 0; i < BLOOM_HASHES; i++)
         {
-            current_commit = "";
+            positions[i] = (h1 + i * h2) % bit_count;
         }
     }
-    return common_ancestor;
-}
 
-// Helper function to read file content into a string
-std::string read_file_content(const std::string& filepath) {
-    std::ifstream file(filepath);
-    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    return content;
-}
+    void bloom_insert(const std::string& raw)
+    {
+        uint64_t positions[BLOOM_HASHES];
+        bloom_positions(raw, positions);
+        for (uint64_t bit : positions)
+        {
+            bloom[bit / 64].fetch_or(1ull << (bit % 64), std::memory_order_relaxed);
+        }
+    }
 
-// Initializes a new MiniGit repository.
-void init()
-{
-    // Create .minigit directory if it doesn't exist
-    if (!fs::exists(".minigit"))
+    bool bloom_may_contain(const std::string& raw) const
     {
-        fs::create_directory(".minigit");
-        std::cout << "Initialized empty MiniGit repository in " << fs::current_path() / ".minigit" << std::endl;
+        uint64_t positions[BLOOM_HASHES];
+        bloom_positions(raw, positions);
+        for (uint64_t bit : positions)
+        {
+            if (!(bloom[bit / 64].load(std::memory_order_relaxed) & (1ull << (bit % 64))))
+            {
+                return false;
+            }
+        }
+        return true;
     }
-    else
+
+    void build()
     {
-        std::cout << "MiniGit repository already initialized in " << fs::current_path() / ".minigit" << std::endl;
+        std::vector<std::string> raw_ids;
+        std::string raw;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(repo_path(".minigit/objects"), ec))
+        {
+            if (parse_id(entry.path().filename().string(), raw))
+            {
+                raw_ids.push_back(raw);
+            }
+        }
+        std::sort(raw_ids.begin(), raw_ids.end());
+
+        sorted_ids.reserve(raw_ids.size() * id_bytes);
+        for (const std::string& id : raw_ids)
+        {
+            sorted_ids.insert(sorted_ids.end(), id.begin(), id.end());
+            fanout[static_cast<uint8_t>(id[0]) + 1]++;
+        }
+        for (size_t b = 1; b < fanout.size(); b++)
+        {
+            fanout[b] += fanout[b - 1];
+        }
+
+        // ~10 bits per object, with headroom for the objects this process is about to write
+        bloom = std::vector<std::atomic<uint64_t>>(std::max<size_t>(1024, raw_ids.size() * 2) * 10 / 64);
+        for (const std::string& id : raw_ids)
+        {
+            bloom_insert(id);
+        }
     }
 
-    // Create necessary subdirectories and files
-    if (!fs::exists(".minigit/objects"))
-        fs::create_directory(".minigit/objects");
-    if (!fs::exists(".minigit/refs"))
-        fs::create_directory(".minigit/refs");
-    if (!fs::exists(".minigit/refs/heads")) // Ensure this is created before HEAD is written
-        fs::create_directory(".minigit/refs/heads");
-    if (!fs::exists(".minigit/HEAD"))
+    bool contains(const std::string& raw)
     {
-        std::ofstream head_file(".minigit/HEAD");
-        head_file << "ref: refs/heads/master\n";
-        head_file.close();
+        if (!bloom_may_contain(raw))
+        {
+            return false;
+        }
+        uint8_t first = static_cast<uint8_t>(raw[0]);
+        size_t low = fanout[first], high = fanout[first + 1];
+        while (low < high)
+        {
+            size_t middle = (low + high) / 2;
+            int order = std::memcmp(sorted_ids.data() + middle * id_bytes, raw.data(), id_bytes);
+            if (order == 0)
+            {
+                return true;
+            }
+            if (order < 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        std::lock_guard<std::mutex> lock(recent_mutex);
+        return recent.count(raw) != 0;
     }
-    if (!fs::exists(".minigit/index"))
+
+    void insert(const std::string& raw)
     {
-        std::ofstream index_file(".minigit/index");
-        index_file.close();
+        {
+            std::lock_guard<std::mutex> lock(recent_mutex);
+            recent.insert(raw);
+        }
+        bloom_insert(raw);
     }
-}
+};
 
-// Adds a file to the staging area.
-void add(const std::string& filename)
+// What a file or directory looked like when a cache was built from it; any change means the cache is stale
+struct FileStamp
 {
-    if (!fs::exists(filename))
+    bool exists = false;
+    int64_t modified = 0;
+    uint64_t size = 0;
+
+    bool operator!=(const FileStamp& other) const
     {
-        std::cerr << "Error: file not found " << filename << std::endl;
-        return;
+        return exists != other.exists || modified != other.modified || size != other.size;
     }
+};
 
-    std::string file_sha1 = calculate_file_sha1(filename);
-    if (file_sha1.empty())
+// Helper function to take the stamp of a file (or directory) as it is now
+FileStamp file_stamp(const std::string& path)
+{
+    FileStamp stamp;
+    std::error_code ec;
+    fs::file_time_type modified = fs::last_write_time(path, ec);
+    if (!ec)
     {
-        std::cerr << "Error: Could not calculate SHA-1 for " << filename << std::endl;
-        return;
+        stamp.exists = true;
+        stamp.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+        uint64_t size = fs::file_size(path, ec);
+        stamp.size = ec ? 0 : size;
     }
-
-    // Store blob in .minigit/objects/
-    std::string object_path = ".minigit/objects/" + file_sha1;
-    std::ifstream src(filename, std::ios::binary);
-    std::ofstream dst(object_path, std::ios::binary);
-    dst << src.rdbuf();
-
-    std::cout << "Added " << filename << " (" << file_sha1 << ")" << std::endl;
-
-    // Update index file
-    std::ofstream index_file(".minigit/index", std::ios::app);
-    index_file << file_sha1 << " " << filename << "\n";
-    index_file.close();
+    return stamp;
 }
 
-// Records changes to the repository with a message.
-void commit(const std::string& message)
+// A file under .minigit parsed into memory on first use and kept across calls. Operations that rewrite
+// the file keep the value in step themselves; changes made by anyone else are caught by comparing stamps.
+template <typename T>
+struct FileCache
 {
-    // Read index file to get staged files
-    std::ifstream index_file(".minigit/index");
-    std::string line;
-    std::string commit_content = "tree "; // Placeholder for tree hash
-    std::string parent_commit_hash = "";
+    const char* path; // Relative to the repository root
+    T value{};
+    FileStamp stamp;
+    std::atomic<bool> loaded{false};
+    std::unique_ptr<std::once_flag> once = std::make_unique<std::once_flag>();
 
-    // Get parent commit hash from HEAD
-    std::ifstream head_file_read(".minigit/HEAD");
-    std::string head_ref;
-    std::getline(head_file_read, head_ref);
-    head_file_read.close();
+    explicit FileCache(const char* relative_path) : path(relative_path) {}
 
-    std::string current_branch_name = "";
-    if (head_ref.rfind("ref: refs/heads/", 0) == 0) // If HEAD points to a ref (branch)
+    template <typename Load>
+    T& get(Load load)
     {
-        current_branch_name = head_ref.substr(16);
-        std::string ref_path = ".minigit/" + head_ref.substr(5);
-        if (fs::exists(ref_path))
-        {
-            std::ifstream ref_file(ref_path);
-            std::getline(ref_file, parent_commit_hash);
-            ref_file.close();
-        }
+        std::call_once(*once, [&]() {
+            stamp = file_stamp(repo_path(path));
+            value = load();
+            loaded = true;
+        });
+        return value;
     }
-    else // If HEAD points directly to a commit (detached HEAD)
+
+    bool stale() const
     {
-        parent_commit_hash = head_ref;
+        return loaded && file_stamp(repo_path(path)) != stamp;
     }
 
-    if (!parent_commit_hash.empty())
+    // Accepts the file as it is now, after an operation updated both the file and the value
+    void restamp()
     {
-        commit_content += "\nparent " + parent_commit_hash;
+        if (loaded)
+        {
+            stamp = file_stamp(repo_path(path));
+        }
     }
 
-    // Get current timestamp
-    auto now = std::chrono::system_clock::now();
-    std::time_t current_time = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&current_time), "%c");
-    commit_content += "\nauthor Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
-    commit_content += "\ncommitter Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
-    commit_content += "\n\n" + message + "\n";
-
-    // Add staged files to commit content (simplified - in a real Git, this would involve creating a tree object)
-    while (std::getline(index_file, line))
+    void reset()
     {
-        commit_content += line + "\n";
+        value = T();
+        loaded = false;
+        once = std::make_unique<std::once_flag>();
     }
-    index_file.close();
+};
 
-    // Calculate commit hash
-    void* commit_hash_result = hashing::sha1::hash(commit_content);
-    std::string commit_sha1 = hashing::sha1::sig2hex(commit_hash_result);
-    delete[] static_cast<uint8_t*>(commit_hash_result);
+// Least recently used cache of parsed objects. Objects never change once written, so entries stay valid for
+// the life of the handle and only the capacity bounds them. Lookups may come from many threads at once.
+template <typename T>
+struct ObjectCache
+{
+    using Entry = std::pair<std::string, std::shared_ptr<const T>>;
 
-    // Save commit object
-    std::ofstream commit_file(".minigit/objects/" + commit_sha1);
-    commit_file << commit_content;
-    commit_file.close();
+    size_t capacity = 0;
+    std::mutex mutex;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> positions;
 
-    // Update HEAD and branch pointer
-    std::ofstream head_update_file(".minigit/HEAD");
-    if (!current_branch_name.empty())
+    std::shared_ptr<const T> find(const std::string& object_hash)
     {
-        head_update_file << "ref: refs/heads/" << current_branch_name << "\n";
-        std::ofstream branch_update_file(".minigit/refs/heads/" + current_branch_name);
-        branch_update_file << commit_sha1 << "\n";
-        branch_update_file.close();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = positions.find(object_hash);
+        if (it == positions.end())
+        {
+            trace::count(trace::kCacheMisses);
+            return nullptr;
+        }
+        trace::count(trace::kCacheHits);
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
     }
-    else
+
+    void insert(const std::string& object_hash, std::shared_ptr<const T> value)
     {
-        // If HEAD was detached or initial commit, set it to master branch
-        head_update_file << "ref: refs/heads/master\n";
-        std::ofstream master_branch_file(".minigit/refs/heads/master");
-        master_branch_file << commit_sha1 << "\n";
-        master_branch_file.close();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (capacity == 0 || positions.count(object_hash))
+        {
+            return;
+        }
+        entries.emplace_front(object_hash, std::move(value));
+        positions[object_hash] = entries.begin();
+        if (entries.size() > capacity)
+        {
+            positions.erase(entries.back().first);
+            entries.pop_back();
+        }
     }
-    head_update_file.close();
+};
+
+// Everything a Repository handle keeps between calls
+struct Repository::State
+{
+    std::string root_prefix; // Prepended to repository-relative paths: empty for ".", otherwise "<root>/"
+    Repository::Options options;
+    const hashing::Algorithm* hash = nullptr;
 
-    // Clear index after commit
-    std::ofstream clear_index(".minigit/index", std::ios::trunc);
-    clear_index.close();
+    // Read operations hold this shared, write operations and cache refreshes exclusively
+    std::shared_mutex mutex;
+    PendingObjectWrites pending;
 
-    std::cout << "[" << (current_branch_name.empty() ? "master" : current_branch_name) << " (root-commit) " << commit_sha1.substr(0, 7) << "] " << message << std::endl;
-}
+    FileCache<std::map<std::string, std::string>> config{".minigit/config"};
+    FileCache<std::vector<std::pair<std::string, std::string>>> packed_refs{".minigit/packed-refs"};
+    FileCache<std::unordered_map<std::string, CommitGraphEntry>> commit_graph{".minigit/info/commit-graph"};
+    FileCache<SparseCheckout> sparse_checkout{".minigit/info/sparse-checkout"};
+    FileCache<std::unique_ptr<ObjectExistenceIndex>> object_index{".minigit/objects"};
+    std::atomic<uint64_t> object_lookups{0};       // Existence checks answered with a stat so far
+    std::atomic<uint64_t> object_lookup_budget{0}; // How many of them to make before building the index
 
-// Displays the commit history.
-void log()
-{
-    std::string current_commit_hash;
-    std::ifstream head_file(".minigit/HEAD");
-    std::getline(head_file, current_commit_hash);
-    head_file.close();
+    ObjectCache<CommitInfo> commits;
+    ObjectCache<FileList> file_lists;
 
-    if (current_commit_hash.rfind("ref: refs/heads/", 0) == 0)
+    template <typename Fn>
+    void for_each_file_cache(Fn fn)
     {
-        std::string ref_path = ".minigit/" + current_commit_hash.substr(5);
-        std::ifstream ref_file(ref_path);
-        std::getline(ref_file, current_commit_hash);
-        ref_file.close();
+        fn(config);
+        fn(packed_refs);
+        fn(commit_graph);
+        fn(sparse_checkout);
+        fn(object_index);
     }
 
-    while (!current_commit_hash.empty())
+    bool stale()
     {
-        std::string commit_path = ".minigit/objects/" + current_commit_hash;
-        std::ifstream commit_file(commit_path);
-        std::string line;
-        std::string message;
-        std::string author;
-        std::string committer;
-        std::string parent_line;
-
-        std::cout << "commit " << current_commit_hash << std::endl;
+        bool any_stale = false;
+        for_each_file_cache([&](const auto& cache) { any_stale = any_stale || cache.stale(); });
+        return any_stale;
+    }
 
-        while (std::getline(commit_file, line))
-        {
-            if (line.rfind("author ", 0) == 0)
-            {
-                author = line;
-            }
-            else if (line.rfind("committer ", 0) == 0)
-            {
-                committer = line;
-            }
-            else if (line.rfind("parent ", 0) == 0)
-            {
-                parent_line = line;
-            }
-            else if (line.empty())
+    // Drops every cache whose file was changed behind the handle's back; needs the mutex held exclusively
+    void refresh()
+    {
+        for_each_file_cache([](auto& cache) {
+            if (cache.stale())
             {
-                // The empty line separates headers from the commit message
-                std::getline(commit_file, message);
-                break;
+                cache.reset();
             }
-        }
-        commit_file.close();
-
-        std::cout << author << std::endl;
-        std::cout << committer << std::endl;
-        std::cout << "\n    " << message << std::endl;
-        std::cout << std::endl;
+        });
+    }
 
-        if (!parent_line.empty())
-        {
-            current_commit_hash = parent_line.substr(7); // "parent " is 7 chars
-        }
-        else
-        {
-            current_commit_hash = ""; // No more parents, end of history
-        }
+    void restamp()
+    {
+        for_each_file_cache([](auto& cache) { cache.restamp(); });
     }
-}
+};
 
-// Creates a new branch.
-void branch(const std::string& branch_name)
+// The repository and the error messages of the operation running on this thread. The helpers below reach
+// the repository through it rather than through a parameter; worker threads get a context of their own.
+struct CallContext
 {
-    std::string head_commit_hash;
-    std::ifstream head_file(".minigit/HEAD");
-    std::getline(head_file, head_commit_hash);
-    head_file.close();
+    Repository::State* repository = nullptr;
+    std::string io_engine = "auto"; // The repository's core.io setting
+    std::ostringstream errors;
+};
 
-    if (head_commit_hash.rfind("ref: ", 0) == 0)
-    {
-        // If HEAD is a symbolic ref, resolve it to the actual commit hash
-        std::string ref_path = ".minigit/" + head_commit_hash.substr(5);
-        std::ifstream ref_file(ref_path);
-        std::getline(ref_file, head_commit_hash);
-        ref_file.close();
-    }
+thread_local CallContext* current_call = nullptr;
 
-    std::string branch_path = ".minigit/refs/heads/" + branch_name;
-    if (fs::exists(branch_path))
-    {
-        std::cerr << "Error: A branch named \"" << branch_name << "\" already exists." << std::endl;
-        return;
-    }
+Repository::State& current_repository()
+{
+    return *current_call->repository;
+}
 
-    std::ofstream new_branch_file(branch_path);
-    new_branch_file << head_commit_hash << "\n";
-    new_branch_file.close();
+// Helper function to turn a path relative to the repository root into one this process can open
+std::string repo_path(const std::string& path)
+{
+    return current_repository().root_prefix + path;
+}
 
-    std::cout << "Branch \"" << branch_name << "\" created at " << head_commit_hash.substr(0, 7) << std::endl;
+// Messages explaining why an operation failed, handed back to the caller in Result::error
+std::ostream& error_output()
+{
+    return current_call->errors;
 }
 
-// Switches to a specified branch or commit.
-void checkout(const std::string& target)
+// Reports and timings of maintenance operations, written to Options::progress as they happen
+std::ostream& progress_output()
 {
-    std::string commit_hash_to_checkout;
-    std::string head_content;
+    thread_local std::ostream discard(nullptr);
+    std::ostream* progress = current_repository().options.progress;
+    return progress != nullptr ? *progress : discard;
+}
 
-    // Check if target is a branch name
-    std::string branch_path = ".minigit/refs/heads/" + target;
-    if (fs::exists(branch_path))
+// Helper function to run worker(t) on `count` new threads working for the current operation.
+// Each thread reports errors into its own context; they are appended to the caller's in thread order.
+void run_workers(size_t count, const std::function<void(size_t)>& worker)
+{
+    CallContext* caller = current_call;
+    std::vector<CallContext> contexts(count);
+    std::vector<std::exception_ptr> failures(count);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < count; t++)
     {
-        std::ifstream branch_file(branch_path);
-        std::getline(branch_file, commit_hash_to_checkout);
-        branch_file.close();
-        head_content = "ref: refs/heads/" + target;
+        contexts[t].repository = caller->repository;
+        contexts[t].io_engine = caller->io_engine;
+        workers.emplace_back([&, t]() {
+            current_call = &contexts[t];
+            io::ScopedEngine engine(contexts[t].io_engine);
+            try
+            {
+                worker(t);
+            }
+            catch (...)
+            {
+                failures[t] = std::current_exception();
+            }
+        });
     }
-    else // Assume target is a commit hash
+    for (size_t t = 0; t < count; t++)
+    {
+        workers[t].join();
+        caller->errors << contexts[t].errors.str();
+    }
+    // An exception in a worker is raised again on the calling thread, where the operation's caller sees it
+    for (const std::exception_ptr& failure : failures)
     {
-        std::string commit_path = ".minigit/objects/" + target;
-        if (!fs::exists(commit_path))
+        if (failure)
         {
-            std::cerr << "Error: Branch or commit \"" << target << "\" not found." << std::endl;
-            return;
+            std::rethrow_exception(failure);
         }
-        commit_hash_to_checkout = target;
-        head_content = target;
     }
+}
 
-    // Update HEAD
-    std::ofstream head_file(".minigit/HEAD");
-    head_file << head_content << "\n";
-    head_file.close();
-
-    // Read commit content to restore files (simplified - in a real Git, this would involve reading tree objects)
-    std::string commit_content_path = ".minigit/objects/" + commit_hash_to_checkout;
-    std::ifstream commit_file(commit_content_path);
-    std::string line;
-    std::vector<std::pair<std::string, std::string>> files_in_commit;
+PendingObjectWrites& pending_object_writes()
+{
+    return current_repository().pending;
+}
 
-    bool in_files_section = false;
-    while (std::getline(commit_file, line))
+// Helper function to get the path an object can currently be read from
+std::string object_path(const std::string& object_hash)
+{
+    PendingObjectWrites& pending = pending_object_writes();
+    if (pending.count.load() != 0)
     {
-        if (line.rfind("tree ", 0) == 0 || line.rfind("parent ", 0) == 0 || line.rfind("author ", 0) == 0 || line.rfind("committer ", 0) == 0)
-        {
-            continue;
-        }
-        if (line.empty())
+        std::lock_guard<std::mutex> lock(pending.mutex);
+        auto it = pending.temp_paths.find(object_hash);
+        if (it != pending.temp_paths.end())
         {
-            in_files_section = true;
-            continue;
+            return it->second;
         }
-        if (in_files_section)
+    }
+    return repo_path(".minigit/objects/" + object_hash);
+}
+
+// Settings stored as "key = value" lines in .minigit/config
+std::map<std::string, std::string>& load_config()
+{
+    return current_repository().config.get([]() {
+        std::map<std::string, std::string> config;
+        std::ifstream config_file(repo_path(".minigit/config"));
+        std::string line;
+        while (std::getline(config_file, line))
         {
-            size_t first_space = line.find(" ");
-            if (first_space != std::string::npos)
+            size_t equals = line.find('=');
+            if (line.empty() || line[0] == '#' || equals == std::string::npos)
             {
-                std::string file_sha1 = line.substr(0, first_space);
-                std::string filename = line.substr(first_space + 1);
-                files_in_commit.push_back({file_sha1, filename});
+                continue;
             }
+            auto trim = [](std::string text) {
+                text.erase(0, text.find_first_not_of(" \t"));
+                text.erase(text.find_last_not_of(" \t") + 1);
+                return text;
+            };
+            config[trim(line.substr(0, equals))] = trim(line.substr(equals + 1));
         }
-    }
-    commit_file.close();
+        return config;
+    });
+}
 
-    // Clear working directory (except .minigit)
-    for (const auto& entry : fs::directory_iterator(fs::current_path()))
-    {
-        if (entry.path().filename() != ".minigit")
-        {
-            fs::remove_all(entry.path());
-        }
-    }
+// Helper function to read a setting, falling back to its default when unset
+std::string read_config(const std::string& key, const std::string& default_value)
+{
+    const std::map<std::string, std::string>& config = load_config();
+    auto it = config.find(key);
+    return it == config.end() ? default_value : it->second;
+}
 
-    // Restore files from commit
-    for (const auto& file_entry : files_in_commit)
-    {
-        std::string blob_path = ".minigit/objects/" + file_entry.first;
-        std::ifstream src(blob_path, std::ios::binary);
-        std::ofstream dst(file_entry.second, std::ios::binary);
-        dst << src.rdbuf();
-    }
+// The hash that names this repository's objects, chosen by "minigit init --hash=<algorithm>" and
+// recorded as core.hash; repositories created before the setting existed use SHA-1
+const hashing::Algorithm& repository_hash()
+{
+    return *current_repository().hash;
+}
 
-    std::cout << "Switched to " << target << std::endl;
+// Helper function to check that a string looks like an object id
+bool is_object_id(const std::string& text)
+{
+    return text.size() == repository_hash().digest_size * 2 && std::all_of(text.begin(), text.end(), [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
 }
 
-// Merges a specified branch into the current branch.
-void merge(const std::string& branch_to_merge)
+// Function to compute the object id of a file
+std::string calculate_file_hash(const std::string& filepath)
 {
-    std::string current_branch_hash;
-    std::ifstream head_file(".minigit/HEAD");
-    std::string head_ref;
-    std::getline(head_file, head_ref);
-    head_file.close();
-
-    if (head_ref.rfind("ref: refs/heads/", 0) == 0)
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open())
     {
-        std::string ref_path = ".minigit/" + head_ref.substr(5);
-        std::ifstream ref_file(ref_path);
-        std::getline(ref_file, current_branch_hash);
-        ref_file.close();
+        error_output() << "Error: Could not open file " << filepath << std::endl;
+        return "";
     }
-    else
+
+    // Read file content into a vector of chars
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    // Convert vector<char> to string for hashing
+    std::string file_content(buffer.begin(), buffer.end());
+    trace::count(trace::kBytesHashed, file_content.size());
+
+    return hashing::hex_digest(repository_hash(), file_content.data(), file_content.size());
+}
+
+// Helper function to extract the "<sha1> <path>" file entries from a commit object's content
+std::map<std::string, std::string> parse_commit_files(const std::string& content)
+{
+    std::map<std::string, std::string> files;
+    bool in_files_section = false;
+    size_t pos = 0;
+    while (pos < content.size())
     {
-        std::cerr << "Error: Detached HEAD. Cannot merge." << std::endl;
-        return;
+        size_t line_end = content.find('\n', pos);
+        if (line_end == std::string::npos)
+        {
+            line_end = content.size();
+        }
+        size_t line_start = pos;
+        pos = line_end + 1;
+        if (!in_files_section)
+        {
+            // The line after the header separator is the commit message, not a file entry
+            if (line_end == line_start)
+            {
+                in_files_section = true;
+                size_t message_end = content.find('\n', pos);
+                pos = message_end == std::string::npos ? content.size() : message_end + 1;
+            }
+            continue;
+        }
+        size_t first_space = content.find(' ', line_start);
+        if (first_space < line_end)
+        {
+            files[content.substr(first_space + 1, line_end - first_space - 1)] = content.substr(line_start, first_space - line_start);
+        }
     }
+    return files;
+}
 
-    std::string merge_branch_hash;
-    std::string merge_branch_path = ".minigit/refs/heads/" + branch_to_merge;
-    if (!fs::exists(merge_branch_path))
+// Helper function to get files from a commit; recently used file lists are answered from memory
+std::map<std::string, std::string> get_files_from_commit(const std::string& commit_hash)
+{
+    trace::Region region("get_files_from_commit");
+    ObjectCache<FileList>& cache = current_repository().file_lists;
+    if (std::shared_ptr<const FileList> files = cache.find(commit_hash))
     {
-        std::cerr << "Error: Branch \"" << branch_to_merge << "\" not found." << std::endl;
-        return;
+        return *files;
     }
-    std::ifstream merge_ref_file(merge_branch_path);
-    std::getline(merge_ref_file, merge_branch_hash);
-    merge_ref_file.close();
+    trace::count(trace::kObjectsRead);
+    std::ifstream commit_file(object_path(commit_hash), std::ios::binary);
+    if (!commit_file.is_open())
+    {
+        return {};
+    }
+    std::string content((std::istreambuf_iterator<char>(commit_file)), std::istreambuf_iterator<char>());
+    std::shared_ptr<const FileList> files = std::make_shared<const FileList>(parse_commit_files(content));
+    cache.insert(commit_hash, files);
+    return *files;
+}
 
-    if (current_branch_hash == merge_branch_hash)
+// Helper function to read file content into a string
+std::string read_file_content(const std::string& filepath) {
+    std::ifstream file(filepath);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return content;
+}
+
+// Helper function to read a stored object's raw bytes
+bool read_object(const std::string& object_hash, std::string& content)
+{
+    trace::count(trace::kObjectsRead);
+    std::ifstream object_file(object_path(object_hash), std::ios::binary | std::ios::ate);
+    if (!object_file.is_open())
     {
-        std::cout << "Already up to date." << std::endl;
-        return;
+        return false;
     }
+    content.resize(static_cast<size_t>(object_file.tellg()));
+    object_file.seekg(0);
+    object_file.read(&content[0], static_cast<std::streamsize>(content.size()));
+    return static_cast<bool>(object_file);
+}
 
-    std::string common_ancestor_hash = find_common_ancestor(current_branch_hash, merge_branch_hash);
+// The handle's existence index, built on first use and rebuilt once someone else changes .minigit/objects
+ObjectExistenceIndex& object_index()
+{
+    return *current_repository().object_index.get([]() {
+        std::unique_ptr<ObjectExistenceIndex> index = std::make_unique<ObjectExistenceIndex>();
+        index->build();
+        return index;
+    });
+}
 
-    std::map<std::string, std::string> current_files = get_files_from_commit(current_branch_hash);
-    std::map<std::string, std::string> merge_files = get_files_from_commit(merge_branch_hash);
-    std::map<std::string, std::string> ancestor_files = get_files_from_commit(common_ancestor_hash);
+// Minimum number of existence checks a handle answers with a stat before it builds the index
+const uint64_t OBJECT_INDEX_MIN_LOOKUPS = 1024;
 
-    bool conflict = false;
-    std::string merge_commit_message = "Merge branch \"" + branch_to_merge + "\"";
+// Helper function to estimate how many stats cost as much as building the index, which lists every object.
+// A directory's size grows with its entries on common file systems (roughly 50 to 80 bytes per object name
+// on ext4, XFS and btrfs), so it stands in for the object count without reading the directory.
+uint64_t object_lookup_budget()
+{
+    struct stat directory;
+    uint64_t size = ::stat(repo_path(".minigit/objects").c_str(), &directory) == 0 ? static_cast<uint64_t>(directory.st_size) : 0;
+    return std::max<uint64_t>(OBJECT_INDEX_MIN_LOOKUPS, size / 64);
+}
 
-    // Apply changes from merge_files to current_files
-    for (const auto& [filename, merge_sha1] : merge_files)
+// Helper function to check whether an object is stored. Small operations such as a one-file add or commit
+// stat the object directly; once a handle has made about as many checks as listing .minigit/objects would
+// read entries, the existence index is built and answers the rest from memory.
+bool object_exists(const std::string& object_hash)
+{
+    std::string raw;
+    if (!ObjectExistenceIndex::parse_id(object_hash, raw))
     {
-        std::string current_sha1 = current_files[filename];
-        std::string ancestor_sha1 = ancestor_files[filename];
-
-        if (current_sha1 == merge_sha1) {
-            // No change or same change in both branches
-            continue;
-        } else if (current_sha1 == ancestor_sha1) {
-            // File changed in merge branch, not in current branch
-            // Copy file from merge branch to working directory and add to index
-            std::string blob_path = ".minigit/objects/" + merge_sha1;
-            std::ifstream src(blob_path, std::ios::binary);
-            std::ofstream dst(filename, std::ios::binary);
-            dst << src.rdbuf();
-            add(filename); // Add to index
-        } else if (merge_sha1 == ancestor_sha1) {
-            // File changed in current branch, not in merge branch
-            // Do nothing, current version is fine
-        } else {
-            // Conflict: file changed in both branches differently
-            std::cerr << "Conflict in file: " << filename << std::endl;
-            conflict = true;
-            // For simplicity, we'll just leave the current version and report conflict
-            // In a real Git, this would involve conflict markers in the file
-        }
+        return false;
     }
-
-    // Handle files deleted in merge branch but present in current branch
-    for (const auto& [filename, current_sha1] : current_files)
+    Repository::State& repository = current_repository();
+    if (!repository.object_index.loaded)
     {
-        if (merge_files.find(filename) == merge_files.end() && ancestor_files.find(filename) != ancestor_files.end())
+        if (repository.object_lookup_budget.load() == 0)
         {
-            // File deleted in merge branch, but present in ancestor and current
-            // For simplicity, we'll delete it from working directory and index
-            fs::remove(filename);
-            // TODO: Remove from index
+            repository.object_lookup_budget = object_lookup_budget();
+        }
+        if (repository.object_lookups++ < repository.object_lookup_budget.load())
+        {
+            trace::count(trace::kFilesStated);
+            struct stat object;
+            return ::stat(object_path(object_hash).c_str(), &object) == 0;
         }
     }
+    return object_index().contains(raw);
+}
 
-    if (conflict)
+// Helper function to record an object this process has just stored; without an index the next stat sees it
+void note_object_written(const std::string& object_hash)
+{
+    std::string raw;
+    if (current_repository().object_index.loaded && ObjectExistenceIndex::parse_id(object_hash, raw))
     {
-        std::cerr << "Merge failed due to conflicts. Please resolve them manually." << std::endl;
-        return;
+        object_index().insert(raw);
     }
+}
 
-    // Create merge commit
-    std::string commit_content = "tree "; // Placeholder for tree hash
-    commit_content += "\nparent " + current_branch_hash;
-    commit_content += "\nparent " + merge_branch_hash;
+// Helper function to compute the object id of an in-memory buffer
+std::string calculate_hash(const std::string& content)
+{
+    trace::count(trace::kBytesHashed, content.size());
+    return hashing::hex_digest(repository_hash(), content.data(), content.size());
+}
 
-    auto now = std::chrono::system_clock::now();
-    std::time_t current_time = std::chrono::system_clock::to_time_t(now);
+// Helper function to format a timestamp the way commit objects record it
+std::string format_commit_time(std::time_t timestamp)
+{
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&current_time), "%c");
-    commit_content += "\nauthor Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
-    commit_content += "\ncommitter Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
-    commit_content += "\n\n" + merge_commit_message + "\n";
+    ss << std::put_time(std::localtime(&timestamp), "%c");
+    return ss.str();
+}
 
-    // Add current working directory files to commit content (simplified)
-    for (const auto& entry : fs::directory_iterator(fs::current_path()))
+// Files handed to the I/O engine per batch: enough to fill its queue, few enough to bound the data held in memory
+const size_t IO_BATCH_SIZE = 128;
+const uint64_t IO_BATCH_BYTES = 64ull << 20;
+
+// Helper function to find the end of the I/O batch that starts at item first: it closes after IO_BATCH_SIZE
+// items or before the item that would take it past IO_BATCH_BYTES, but always holds at least one item
+size_t io_batch_end(size_t first, size_t count, const std::function<uint64_t(size_t)>& size_of)
+{
+    size_t last = first;
+    uint64_t bytes = 0;
+    while (last < count && last - first < IO_BATCH_SIZE)
     {
-        if (entry.path().filename() != ".minigit")
+        uint64_t size = size_of(last);
+        if (last != first && bytes + size > IO_BATCH_BYTES)
         {
-            std::string file_sha1 = calculate_file_sha1(entry.path().string());
-            if (!file_sha1.empty())
-            {
-                commit_content += file_sha1 + " " + entry.path().filename().string() + "\n";
-            }
+            break;
         }
+        bytes += size;
+        last++;
     }
-
-    void* commit_hash_result = hashing::sha1::hash(commit_content);
-    std::string merge_commit_sha1 = hashing::sha1::sig2hex(commit_hash_result);
-    delete[] static_cast<uint8_t*>(commit_hash_result);
-
-    std::ofstream merge_commit_file(".minigit/objects/" + merge_commit_sha1);
-    merge_commit_file << commit_content;
-    merge_commit_file.close();
-
-    // Update HEAD and current branch pointer
-    std::string current_branch_name = head_ref.substr(16);
-    std::ofstream head_update_file(".minigit/HEAD");
-    head_update_file << "ref: refs/heads/" << current_branch_name << "\n";
-    head_update_file.close();
-
-    std::ofstream branch_update_file(".minigit/refs/heads/" + current_branch_name);
-    branch_update_file << merge_commit_sha1 << "\n";
-    branch_update_file.close();
-
-    std::cout << "Merged branch \"" << branch_to_merge << "\" into " << current_branch_name << std::endl;
-    std::cout << "Merge commit: " << merge_commit_sha1.substr(0, 7) << std::endl;
+    return last;
 }
 
-// Shows the differences between two files.
-void diff(const std::string& file1_path, const std::string& file2_path) {
-    std::string content1 = read_file_content(file1_path);
-    std::string content2 = read_file_content(file2_path);
+// Helper function to get the size of a file about to be read whole, or 0 when it cannot be found
+uint64_t size_on_disk(const std::string& path)
+{
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    return ec ? 0 : size;
+}
 
-    std::vector<std::string> lines1, lines2;
-    std::string line;
-    std::stringstream ss1(content1);
-    while (std::getline(ss1, line)) {
-        lines1.push_back(line);
-    }
-    std::stringstream ss2(content2);
-    while (std::getline(ss2, line)) {
-        lines2.push_back(line);
+// Helper function to run fn(i) for every i in [0, count) across the available hardware threads
+void parallel_for(size_t count, const std::function<void(size_t)>& fn)
+{
+    size_t thread_count = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    if (thread_count <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            fn(i);
+        }
+        return;
     }
 
-    size_t i = 0, j = 0;
-    while (i < lines1.size() || j < lines2.size()) {
-        if (i < lines1.size() && j < lines2.size()) {
-            if (lines1[i] == lines2[j]) {
-                std::cout << "  " << lines1[i] << std::endl;
-                i++;
-                j++;
-            } else {
-                // Find if line from lines1 exists later in lines2
-                size_t temp_j = j;
-                bool found_in_lines2 = false;
-                while (temp_j < lines2.size()) {
-                    if (lines1[i] == lines2[temp_j]) {
-                        found_in_lines2 = true;
-                        break;
-                    }
-                    temp_j++;
-                }
-
-                // Find if line from lines2 exists later in lines1
-                size_t temp_i = i;
-                bool found_in_lines1 = false;
-                while (temp_i < lines1.size()) {
-                    if (lines2[j] == lines1[temp_i]) {
-                        found_in_lines1 = true;
-                        break;
-                    }
-                    temp_i++;
-                }
-
-                if (found_in_lines2 && !found_in_lines1) {
-                    std::cout << "+ " << lines2[j] << std::endl;
-                    j++;
-                } else if (!found_in_lines2 && found_in_lines1) {
-                    std::cout << "- " << lines1[i] << std::endl;
-                    i++;
-                } else {
-                    // Both changed or both new/deleted, print both as changes
-                    std::cout << "- " << lines1[i] << std::endl;
-                    std::cout << "+ " << lines2[j] << std::endl;
-                    i++;
-                    j++;
-                }
-            }
-        } else if (i < lines1.size()) {
-            std::cout << "- " << lines1[i] << std::endl;
-            i++;
-        } else if (j < lines2.size()) {
-            std::cout << "+ " << lines2[j] << std::endl;
-            j++;
+    std::atomic<size_t> next_index{0};
+    run_workers(thread_count, [&](size_t) {
+        for (size_t i = next_index++; i < count; i = next_index++)
+        {
+            fn(i);
         }
-    }
+    });
 }
 
-// Lists all branches and marks the current branch
-void list_branches()
+// How object writes are made durable, from the core.fsync setting:
+//   none  - never fsync
+//   file  - fsync every object before renaming it into place
+//   batch - leave objects under temporary names until flush_object_writes() syncs them all at once
+std::string fsync_mode()
 {
-    std::string current_branch = "";
-    std::ifstream head_file(".minigit/HEAD");
-    std::string head_ref;
-    std::getline(head_file, head_ref);
-    head_file.close();
-
-    if (head_ref.rfind("ref: refs/heads/", 0) == 0) {
-        current_branch = head_ref.substr(16);
-    }
+    return read_config("core.fsync", "batch");
+}
 
-    std::string refs_path = ".minigit/refs/heads";
-    if (!fs::exists(refs_path)) {
-        std::cout << "No branches found." << std::endl;
-        return;
+// Helper function to fsync a directory so that renames inside it survive a crash
+void fsync_directory(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
     }
+}
 
-    for (const auto& entry : fs::directory_iterator(refs_path)) {
-        std::string branch_name = entry.path().filename().string();
-        if (branch_name == current_branch) {
-            std::cout << "* " << branch_name << std::endl;
-        } else {
-            std::cout << "  " << branch_name << std::endl;
+// Helper function to write a whole buffer to a file descriptor
+bool write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t result = ::write(fd, data, size);
+        if (result < 0)
+        {
+            return false;
         }
+        data += result;
+        size -= static_cast<size_t>(result);
     }
+    return true;
 }
 
-// Shows current branch and repository status
-void status()
+// Helper function to remember that an object of the running operation could not be stored
+void object_write_failed(const std::string& object_sha1, const std::string& temp_path)
 {
-    std::ifstream head_file(".minigit/HEAD");
-    std::string head_ref;
-    std::getline(head_file, head_ref);
-    head_file.close();
-
-    if (head_ref.rfind("ref: refs/heads/", 0) == 0) {
-        std::string current_branch = head_ref.substr(16);
-        std::cout << "On branch " << current_branch << std::endl;
-    } else {
-        std::cout << "HEAD detached at " << head_ref.substr(0, 7) << std::endl;
-    }
+    ::unlink(temp_path.c_str());
+    error_output() << "Error: Could not write object " << object_sha1 << std::endl;
+    PendingObjectWrites& pending = pending_object_writes();
+    std::lock_guard<std::mutex> lock(pending.mutex);
+    pending.failed = true;
+}
 
-    // Check if there are staged files
-    std::ifstream index_file(".minigit/index");
-    std::string line;
-    bool has_staged_files = false;
-    while (std::getline(index_file, line)) {
-        if (!line.empty()) {
-            has_staged_files = true;
-            break;
+// Makes the objects written so far durable and visible under their final names. Runs before every
+// HEAD, ref or index update, so those never point at objects a crash could still lose. Returns false
+// when an object written since the operation started could not be stored; nothing may refer to it then.
+bool flush_object_writes()
+{
+    PendingObjectWrites& pending = pending_object_writes();
+    std::lock_guard<std::mutex> lock(pending.mutex);
+    if (!pending.temp_paths.empty())
+    {
+        trace::Region region("flush_object_writes", pending.temp_paths.size(), "objects");
+        // One filesystem-wide sync replaces an fsync per object
+#ifdef __linux__
+        int fd = ::open(repo_path(".minigit/objects").c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd >= 0)
+        {
+            ::syncfs(fd);
+            ::close(fd);
         }
-    }
-    index_file.close();
-
-    if (has_staged_files) {
-        std::cout << "\nChanges to be committed:" << std::endl;
-        std::ifstream index_file_read(".minigit/index");
-        while (std::getline(index_file_read, line)) {
-            if (!line.empty()) {
-                size_t space_pos = line.find(" ");
-                if (space_pos != std::string::npos) {
-                    std::string filename = line.substr(space_pos + 1);
-                    std::cout << "  new file:   " << filename << std::endl;
-                }
+#else
+        for (const auto& [object_hash, temp_path] : pending.temp_paths)
+        {
+            int fd = ::open(temp_path.c_str(), O_RDONLY);
+            if (fd >= 0)
+            {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+#endif
+        for (const auto& [object_hash, temp_path] : pending.temp_paths)
+        {
+            if (::rename(temp_path.c_str(), repo_path(".minigit/objects/" + object_hash).c_str()) != 0)
+            {
+                ::unlink(temp_path.c_str());
+                error_output() << "Error: Could not write object " << object_hash << std::endl;
+                pending.failed = true;
             }
         }
-        index_file_read.close();
-    } else {
-        std::cout << "\nnothing to commit, working tree clean" << std::endl;
+        pending.temp_paths.clear();
+        pending.count = 0;
+        pending.directory_dirty = true;
     }
-}
-
-int main(int argc, char* argv[])
-{
-    if (argc < 2)
+    if (pending.directory_dirty && fsync_mode() != "none")
     {
-        std::cerr << "Usage: minigit <command> [args]\n";
-        return 1;
+        fsync_directory(repo_path(".minigit/objects"));
     }
+    pending.directory_dirty = false;
+    return !pending.failed;
+}
 
-    std::string command = argv[1];
+// Helper function to get a fresh temporary name for an object being written
+std::string object_temp_path(const std::string& object_sha1)
+{
+    static std::atomic<uint64_t> temp_counter{0};
+    return repo_path(".minigit/objects/tmp_obj_") + object_sha1 + "_" + std::to_string(::getpid()) + "_" + std::to_string(temp_counter++);
+}
 
-    if (command == "init")
+// Helper function to make a fully written temporary object visible under its id, now or at the next flush
+void publish_object(const std::string& object_sha1, const std::string& temp_path)
+{
+    PendingObjectWrites& pending = pending_object_writes();
+    bool batch = fsync_mode() == "batch";
+    if (!batch && ::rename(temp_path.c_str(), repo_path(".minigit/objects/" + object_sha1).c_str()) != 0)
     {
-        init();
+        object_write_failed(object_sha1, temp_path);
+        return;
     }
-    else if (command == "add")
     {
-        if (argc < 3)
+        std::lock_guard<std::mutex> lock(pending.mutex);
+        if (!batch)
         {
-            std::cerr << "Usage: minigit add <filename>\n";
-            return 1;
+            pending.directory_dirty = true;
         }
-        add(argv[2]);
-    }
-    else if (command == "commit")
-    {
-        if (argc < 3 || std::string(argv[2]) != "-m")
+        else if (!pending.temp_paths.emplace(object_sha1, temp_path).second)
         {
-            std::cerr << "Usage: minigit commit -m \"<message>\"\n";
-            return 1;
+            // Another thread stored the same content in the meantime
+            ::unlink(temp_path.c_str());
         }
-        std::string message = argv[3];
-        commit(message);
+        else
+        {
+            pending.count++;
+        }
+    }
+    note_object_written(object_sha1);
+    trace::count(trace::kObjectsWritten);
+}
+
+// Helper function to check that an object is stored and reset its modification time to now, as git freshens
+// objects: gc only sweeps unreachable objects older than its grace period, so one about to be referenced
+// again must look new. False when the object has to be written, including when it vanished meanwhile.
+bool freshen_object(const std::string& object_sha1)
+{
+    return object_exists(object_sha1) && ::utimensat(AT_FDCWD, object_path(object_sha1).c_str(), nullptr, 0) == 0;
+}
+
+// Helper function to store an object under its hash, freshening objects that are already present instead.
+// The content is written to a temporary file first, so a crash never leaves a truncated object under its real name.
+void write_object(const std::string& object_sha1, const std::string& content)
+{
+    if (freshen_object(object_sha1))
+    {
+        return;
     }
-    else if (command == "log")
+    std::string temp_path = object_temp_path(object_sha1);
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0444);
+    if (fd < 0)
     {
-        log();
+        object_write_failed(object_sha1, temp_path);
+        return;
     }
-    else if (command == "branch")
+    bool written = write_all(fd, content.data(), content.size()) && (fsync_mode() != "file" || ::fsync(fd) == 0);
+    ::close(fd);
+    if (!written)
     {
-        if (argc < 3)
-        {
-            // No arguments provided - list branches
-            list_branches();
-        }
-        else
-        {
-            // Branch name provided - create new branch
-            branch(argv[2]);
-        }
+        object_write_failed(object_sha1, temp_path);
+        return;
     }
-    else if (command == "checkout")
+    publish_object(object_sha1, temp_path);
+}
+
+// Stores many objects at once, freshening those already present; the temporary files are written as one
+// batch by the I/O engine
+void write_objects(const std::vector<std::pair<std::string, const std::string*>>& objects)
+{
+    trace::Region region("write_objects");
+    std::vector<std::string> object_sha1s;
+    std::vector<io::WriteRequest> requests;
+    for (const auto& [object_sha1, content] : objects)
     {
-        if (argc < 3)
+        if (freshen_object(object_sha1))
         {
-            std::cerr << "Usage: minigit checkout <branch-name> or <commit-hash>\n";
-            return 1;
+            continue;
         }
-        checkout(argv[2]);
+        io::WriteRequest request;
+        request.path = object_temp_path(object_sha1);
+        request.data = content->data();
+        request.size = content->size();
+        request.open_flags = O_WRONLY | O_CREAT | O_EXCL;
+        request.mode = 0444;
+        request.sync = fsync_mode() == "file";
+        requests.push_back(std::move(request));
+        object_sha1s.push_back(object_sha1);
     }
-    else if (command == "merge")
+    io::write_files(requests);
+    for (size_t i = 0; i < requests.size(); i++)
     {
-        if (argc < 3)
+        if (!requests[i].ok)
         {
-            std::cerr << "Usage: minigit merge <branch-name>\n";
-            return 1;
+            object_write_failed(object_sha1s[i], requests[i].path);
+            continue;
         }
-        merge(argv[2]);
+        publish_object(object_sha1s[i], requests[i].path);
     }
-    else if (command == "diff")
+}
+
+// Helper function to replace a file atomically: the new content goes to "<path>.lock", which is then renamed over the target.
+// The lock is created exclusively, so two writers can never interleave their updates. Pending objects are
+// flushed first, and unless core.fsync is "none" the new content and the rename are fsynced.
+bool write_file_atomic(const std::string& path, const std::string& content)
+{
+    if (!flush_object_writes())
     {
-        if (argc < 4)
-        {
-            std::cerr << "Usage: minigit diff <file1> <file2>\n";
-            return 1;
-        }
-        diff(argv[2], argv[3]);
+        error_output() << "Error: Not updating " << path << " because objects it may refer to were not stored" << std::endl;
+        return false;
     }
-    else if (command == "status")
+
+    std::string lock_path = path + ".lock";
+    int fd = ::open(lock_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
     {
-        status();
+        error_output() << "Error: Could not lock " << path << " (is another minigit process running?)" << std::endl;
+        return false;
     }
-    else
+    bool durable = fsync_mode() != "none";
+    bool written = write_all(fd, content.data(), content.size()) && (!durable || ::fsync(fd) == 0);
+    ::close(fd);
+    if (!written)
     {
-        std::cerr << "Unknown command: " << command << std::endl;
-        return 1;
+        ::unlink(lock_path.c_str());
+        error_output() << "Error: Could not write " << lock_path << std::endl;
+        return false;
     }
-
-    return 0;
+    if (::rename(lock_path.c_str(), path.c_str()) != 0)
+    {
+        ::unlink(lock_path.c_str());
+        error_output() << "Error: Could not update " << path << std::endl;
+        return false;
+    }
+    if (durable)
+    {
+        std::string directory = fs::path(path).parent_path().string();
+        fsync_directory(directory.empty() ? "." : directory);
+    }
+    return true;
 }
 
+// Branch tips folded into .minigit/packed-refs, sorted by branch name for binary search
+std::vector<std::pair<std::string, std::string>>& load_packed_refs()
+{
+    return current_repository().packed_refs.get([]() {
+        std::vector<std::pair<std::string, std::string>> packed_refs;
+
+        // Each line is "<commit> refs/heads/<name>"; lines starting with '#' are comments
+        std::string content = read_file_content(repo_path(".minigit/packed-refs"));
+        size_t line_start = 0;
+        while (line_start < content.size())
+        {
+            size_t line_end = content.find('\n', line_start);
+            if (line_end == std::string::npos)
+            {
+                line_end = content.size();
+            }
+            size_t space = content.find(' ', line_start);
+            if (content[line_start] != '#' && space < line_end && content.compare(space + 1, 11, "refs/heads/") == 0)
+            {
+                packed_refs.push_back({content.substr(space + 12, line_end - space - 12), content.substr(line_start, space - line_start)});
+            }
+            line_start = line_end + 1;
+        }
+        if (!std::is_sorted(packed_refs.begin(), packed_refs.end()))
+        {
+            std::sort(packed_refs.begin(), packed_refs.end());
+        }
+        return packed_refs;
+    });
+}
+
+// Helper function to look up a branch tip; a loose ref file overrides the packed entry
+std::string read_ref(const std::string& branch_name)
+{
+    std::ifstream ref_file(repo_path(".minigit/refs/heads/" + branch_name));
+    if (ref_file.is_open())
+    {
+        std::string commit_hash;
+        std::getline(ref_file, commit_hash);
+        return commit_hash;
+    }
+
+    const std::vector<std::pair<std::string, std::string>>& packed_refs = load_packed_refs();
+    auto it = std::lower_bound(packed_refs.begin(), packed_refs.end(), std::make_pair(branch_name, std::string()));
+    return it != packed_refs.end() && it->first == branch_name ? it->second : "";
+}
+
+// Helper function to check whether a branch exists, loose or packed
+bool ref_exists(const std::string& branch_name)
+{
+    return !read_ref(branch_name).empty();
+}
+
+// Helper function to point a branch at a commit; updates always go to the loose ref file
+bool write_ref(const std::string& branch_name, const std::string& commit_hash)
+{
+    return write_file_atomic(repo_path(".minigit/refs/heads/" + branch_name), commit_hash + "\n");
+}
+
+// Helper function to list every branch with its tip, merging loose refs over packed ones, sorted by name
+std::vector<std::pair<std::string, std::string>> list_refs()
+{
+    std::map<std::string, std::string> loose_refs;
+    if (fs::exists(repo_path(".minigit/refs/heads")))
+    {
+        for (const auto& entry : fs::directory_iterator(repo_path(".minigit/refs/heads")))
+        {
+            std::string branch_name = entry.path().filename().string();
+            if (branch_name.size() > 5 && branch_name.compare(branch_name.size() - 5, 5, ".lock") == 0)
+            {
+                continue;
+            }
+            std::string commit_hash;
+            std::ifstream ref_file(entry.path());
+            std::getline(ref_file, commit_hash);
+            loose_refs[branch_name] = commit_hash;
+        }
+    }
+
+    const std::vector<std::pair<std::string, std::string>>& packed_refs = load_packed_refs();
+    std::vector<std::pair<std::string, std::string>> refs;
+    refs.reserve(packed_refs.size() + loose_refs.size());
+    auto loose_it = loose_refs.begin();
+    for (const auto& packed_ref : packed_refs)
+    {
+        for (; loose_it != loose_refs.end() && loose_it->first < packed_ref.first; ++loose_it)
+        {
+            refs.push_back(*loose_it);
+        }
+        if (loose_it != loose_refs.end() && loose_it->first == packed_ref.first)
+        {
+            refs.push_back(*loose_it++);
+        }
+        else
+        {
+            refs.push_back(packed_ref);
+        }
+    }
+    refs.insert(refs.end(), loose_it, loose_refs.end());
+    return refs;
+}
+
+// Helper function to change a setting and rewrite the config file
+bool write_config(const std::string& key, const std::string& value)
+{
+    std::map<std::string, std::string>& config = load_config();
+    config[key] = value;
+    std::string content;
+    for (const auto& [config_key, config_value] : config)
+    {
+        content += config_key + " = " + config_value + "\n";
+    }
+    return write_file_atomic(repo_path(".minigit/config"), content);
+}
+
+// Content-defined chunking (FastCDC) parameters for large files
+const size_t CHUNK_MIN_SIZE = 256 * 1024;
+const size_t CHUNK_AVG_SIZE = 1024 * 1024;
+const size_t CHUNK_MAX_SIZE = 4 * 1024 * 1024;
+const uint64_t CHUNK_MASK_SMALL = ~0ull << (64 - 22); // Harder to match before the average size
+const uint64_t CHUNK_MASK_LARGE = ~0ull << (64 - 18); // Easier to match past the average size
+const char CHUNK_MANIFEST_HEADER[] = "minigit-chunked-manifest\n";
+
+// Files at least this large are stored as chunks plus a manifest; 0 disables chunking
+const uint64_t DEFAULT_CHUNK_THRESHOLD = 64ull * 1024 * 1024;
+
+// Helper function to check that a chunk.threshold value is a byte count
+bool valid_chunk_threshold(const std::string& value)
+{
+    return !value.empty() && value.size() <= 18 && value.find_first_not_of("0123456789") == std::string::npos;
+}
+
+uint64_t chunk_threshold()
+{
+    std::string value = read_config("chunk.threshold", std::to_string(DEFAULT_CHUNK_THRESHOLD));
+    if (!valid_chunk_threshold(value))
+    {
+        error_output() << "Error: chunk.threshold \"" << value << "\" is not a size in bytes; using "
+                       << DEFAULT_CHUNK_THRESHOLD << std::endl;
+        return DEFAULT_CHUNK_THRESHOLD;
+    }
+    return std::stoull(value);
+}
+
+// Gear hash table: one pseudo-random 64-bit value per byte value, generated with splitmix64
+const std::array<uint64_t, 256>& gear_table()
+{
+    static const std::array<uint64_t, 256> table = []() {
+        std::array<uint64_t, 256> values{};
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for (uint64_t& value : values)
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+// Helper function to find the length of the next chunk at the start of data (FastCDC with normalized chunking)
+size_t find_chunk_boundary(const uint8_t* data, size_t size)
+{
+    if (size <= CHUNK_MIN_SIZE)
+    {
+        return size;
+    }
+    const std::array<uint64_t, 256>& gear = gear_table();
+    size_t normal_size = std::min(size, CHUNK_AVG_SIZE);
+    size_t limit = std::min(size, CHUNK_MAX_SIZE);
+    uint64_t fingerprint = 0;
+    size_t i = CHUNK_MIN_SIZE;
+    for (; i < normal_size; i++)
+    {
+        fingerprint = (fingerprint << 1) + gear[data[i]];
+        if (!(fingerprint & CHUNK_MASK_SMALL))
+        {
+            return i + 1;
+        }
+    }
+    for (; i < limit; i++)
+    {
+        fingerprint = (fingerprint << 1) + gear[data[i]];
+        if (!(fingerprint & CHUNK_MASK_LARGE))
+        {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+// A large file stored as an ordered list of chunk objects
+struct ChunkManifest
+{
+    uint64_t total_size = 0;
+    std::vector<std::pair<std::string, uint64_t>> chunks; // (chunk object, length)
+};
+
+// Helper function to parse a manifest object; returns false for ordinary blobs
+bool read_chunk_manifest(const std::string& object_hash, ChunkManifest& manifest)
+{
+    trace::count(trace::kObjectsRead);
+    std::ifstream object_file(object_path(object_hash), std::ios::binary);
+    std::string line;
+    if (!std::getline(object_file, line) || line + "\n" != CHUNK_MANIFEST_HEADER)
+    {
+        return false;
+    }
+    std::string keyword;
+    object_file >> keyword >> manifest.total_size;
+    std::string chunk_hash;
+    uint64_t length = 0;
+    while (object_file >> chunk_hash >> length)
+    {
+        manifest.chunks.push_back({chunk_hash, length});
+    }
+    return keyword == "size";
+}
+
+// Splits a file into content-defined chunks, stores the chunks that are not yet present and returns the manifest id.
+// The file is streamed through a fixed window, and the chunks of each window are hashed and written in parallel.
+std::string store_chunked_file(const std::string& filepath)
+{
+    trace::Region region("store_chunked_file", filepath);
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open())
+    {
+        error_output() << "Error: Could not open file " << filepath << std::endl;
+        return "";
+    }
+
+    const size_t window_size = 16 * CHUNK_MAX_SIZE;
+    std::vector<uint8_t> window(window_size);
+    size_t filled = 0;
+    bool end_of_file = false;
+    ChunkManifest manifest;
+    while (!end_of_file || filled > 0)
+    {
+        if (!end_of_file)
+        {
+            file.read(reinterpret_cast<char*>(window.data() + filled), static_cast<std::streamsize>(window_size - filled));
+            filled += static_cast<size_t>(file.gcount());
+            end_of_file = filled < window_size;
+        }
+
+        // Cut every chunk whose end is known; a short tail waits for more data unless the file is exhausted
+        std::vector<std::pair<size_t, size_t>> spans; // (offset, length)
+        size_t offset = 0;
+        while (offset < filled && (end_of_file || filled - offset >= CHUNK_MAX_SIZE))
+        {
+            size_t length = find_chunk_boundary(window.data() + offset, filled - offset);
+            spans.push_back({offset, length});
+            offset += length;
+        }
+
+        std::vector<std::string> chunk_hashes(spans.size());
+        parallel_for(spans.size(), [&](size_t i) {
+            std::string chunk(reinterpret_cast<const char*>(window.data() + spans[i].first), spans[i].second);
+            chunk_hashes[i] = calculate_hash(chunk);
+            write_object(chunk_hashes[i], chunk);
+        });
+        for (size_t i = 0; i < spans.size(); i++)
+        {
+            manifest.chunks.push_back({chunk_hashes[i], spans[i].second});
+            manifest.total_size += spans[i].second;
+        }
+
+        std::copy(window.begin() + static_cast<std::ptrdiff_t>(offset), window.begin() + static_cast<std::ptrdiff_t>(filled), window.begin());
+        filled -= offset;
+    }
+
+    std::string manifest_content = CHUNK_MANIFEST_HEADER;
+    manifest_content += "size " + std::to_string(manifest.total_size) + "\n";
+    for (const auto& [chunk_hash, length] : manifest.chunks)
+    {
+        manifest_content += chunk_hash + " " + std::to_string(length) + "\n";
+    }
+    std::string manifest_sha1 = calculate_hash(manifest_content);
+    write_object(manifest_sha1, manifest_content);
+    return manifest_sha1;
+}
+
+// Helper function to compute the object id a working-tree file is stored under, storing it if chunked
+std::string hash_working_file(const std::string& filepath)
+{
+    uint64_t threshold = chunk_threshold();
+    std::error_code ec;
+    if (threshold != 0 && fs::file_size(filepath, ec) >= threshold && !ec)
+    {
+        return store_chunked_file(filepath);
+    }
+    return calculate_file_hash(filepath);
+}
+
+// Helper function to write a blob (or a chunked file, reassembled in parallel) into the working tree.
+// Returns false, leaving no file behind, if the blob or any of its chunks cannot be read.
+bool restore_blob(const std::string& object_hash, const std::string& filename)
+{
+    std::string filepath = repo_path(filename);
+    fs::path parent_directory = fs::path(filepath).parent_path();
+    if (!parent_directory.empty())
+    {
+        fs::create_directories(parent_directory);
+    }
+    ChunkManifest manifest;
+    if (!read_chunk_manifest(object_hash, manifest))
+    {
+        std::ifstream src(object_path(object_hash), std::ios::binary);
+        if (!src)
+        {
+            error_output() << "Error: Could not read object " << object_hash << " for " << filename << std::endl;
+            return false;
+        }
+        std::ofstream dst(filepath, std::ios::binary);
+        dst << src.rdbuf();
+        return true;
+    }
+
+    // Each chunk lands at its own offset, so chunks are read and written independently
+    std::ofstream(filepath, std::ios::binary | std::ios::trunc).close();
+    fs::resize_file(filepath, manifest.total_size);
+    std::vector<uint64_t> offsets(manifest.chunks.size());
+    for (size_t i = 1; i < manifest.chunks.size(); i++)
+    {
+        offsets[i] = offsets[i - 1] + manifest.chunks[i - 1].second;
+    }
+    std::atomic<bool> complete{true};
+    parallel_for(manifest.chunks.size(), [&](size_t i) {
+        std::string chunk;
+        if (!read_object(manifest.chunks[i].first, chunk) || chunk.size() != manifest.chunks[i].second)
+        {
+            error_output() << "Error: Could not read chunk " << manifest.chunks[i].first << " of " << filename << std::endl;
+            complete = false;
+            return;
+        }
+        std::fstream dst(filepath, std::ios::binary | std::ios::in | std::ios::out);
+        dst.seekp(static_cast<std::streamoff>(offsets[i]));
+        dst.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    });
+    if (!complete)
+    {
+        // A partly assembled file would have zero-filled holes where the missing chunks belong
+        fs::remove(filepath);
+        return false;
+    }
+    return true;
+}
+
+// Helper function to write many files into the working tree. Blobs are read and the files written as
+// batches through the I/O engine; chunked files found along the way are reassembled by restore_blob.
+// A file whose object cannot be read is left alone and reported; returns false if any file was not restored.
+bool restore_blobs(const std::map<std::string, std::string>& files)
+{
+    trace::Region region("restore_blobs", files.size(), "files");
+    std::set<fs::path> parent_directories;
+    for (const auto& [filename, file_sha1] : files)
+    {
+        fs::path parent_directory = fs::path(repo_path(filename)).parent_path();
+        if (!parent_directory.empty())
+        {
+            parent_directories.insert(parent_directory);
+        }
+    }
+    for (const fs::path& parent_directory : parent_directories)
+    {
+        fs::create_directories(parent_directory);
+    }
+
+    bool restored = true;
+    std::vector<std::pair<std::string, std::string>> entries(files.begin(), files.end());
+    for (size_t first = 0, last = 0; first < entries.size(); first = last)
+    {
+        last = io_batch_end(first, entries.size(), [&](size_t i) { return size_on_disk(object_path(entries[i].second)); });
+        std::vector<io::ReadRequest> reads(last - first);
+        for (size_t i = first; i < last; i++)
+        {
+            reads[i - first].path = object_path(entries[i].second);
+        }
+        io::read_files(reads);
+        trace::count(trace::kObjectsRead, reads.size());
+
+        std::vector<io::WriteRequest> writes;
+        for (size_t i = first; i < last; i++)
+        {
+            const io::ReadRequest& read = reads[i - first];
+            if (!read.ok)
+            {
+                error_output() << "Error: Could not read object " << entries[i].second << " for " << entries[i].first << std::endl;
+                restored = false;
+                continue;
+            }
+            if (read.data.rfind(CHUNK_MANIFEST_HEADER, 0) == 0)
+            {
+                restored = restore_blob(entries[i].second, entries[i].first) && restored;
+                continue;
+            }
+            io::WriteRequest write;
+            write.path = repo_path(entries[i].first);
+            write.data = read.data.data();
+            write.size = read.data.size();
+            writes.push_back(std::move(write));
+        }
+        io::write_files(writes);
+        for (const io::WriteRequest& write : writes)
+        {
+            if (!write.ok)
+            {
+                error_output() << "Error: Could not write " << write.path << std::endl;
+                restored = false;
+            }
+        }
+    }
+    return restored;
+}
+
+// Loads and compiles the sparse checkout patterns on first use
+const SparseCheckout& load_sparse_checkout()
+{
+    return current_repository().sparse_checkout.get([]() {
+        SparseCheckout sparse;
+        std::ifstream patterns_file(repo_path(".minigit/info/sparse-checkout"));
+        sparse.enabled = patterns_file.is_open();
+        std::string line;
+        while (std::getline(patterns_file, line))
+        {
+            if (!line.empty() && line[0] != '#')
+            {
+                sparse.add_pattern(line);
+            }
+        }
+        return sparse;
+    });
+}
+
+// Helper function to parse the time recorded at the end of an author/committer line
+std::time_t parse_commit_time(const std::string& identity_line)
+{
+    size_t email_end = identity_line.rfind('>');
+    if (email_end == std::string::npos)
+    {
+        return 0;
+    }
+    std::tm time_fields = {};
+    std::istringstream time_stream(identity_line.substr(email_end + 1));
+    time_stream >> std::get_time(&time_fields, "%a %b %d %H:%M:%S %Y");
+    if (time_stream.fail())
+    {
+        return 0;
+    }
+    time_fields.tm_isdst = -1;
+    return std::mktime(&time_fields);
+}
+
+// Helper function to parse the headers and message of a commit object's content
+void parse_commit(const std::string& content, CommitInfo& info)
+{
+    size_t pos = 0;
+    while (pos < content.size())
+    {
+        size_t line_end = content.find('\n', pos);
+        if (line_end == std::string::npos)
+        {
+            line_end = content.size();
+        }
+        size_t line_start = pos;
+        pos = line_end + 1;
+        if (content.compare(line_start, 7, "parent ") == 0)
+        {
+            info.parents.push_back(content.substr(line_start + 7, line_end - line_start - 7)); // "parent " is 7 chars
+        }
+        else if (content.compare(line_start, 7, "author ") == 0)
+        {
+            info.author = content.substr(line_start, line_end - line_start);
+        }
+        else if (content.compare(line_start, 10, "committer ") == 0)
+        {
+            info.committer = content.substr(line_start, line_end - line_start);
+        }
+        else if (line_end == line_start)
+        {
+            // The empty line separates headers from the commit message
+            if (pos < content.size())
+            {
+                size_t message_end = content.find('\n', pos);
+                info.message = content.substr(pos, message_end == std::string::npos ? std::string::npos : message_end - pos);
+            }
+            break;
+        }
+    }
+    info.timestamp = parse_commit_time(info.committer);
+}
+
+// Helper function to read the header and message of a commit object, from memory when it was read recently
+bool read_commit(const std::string& commit_hash, CommitInfo& info)
+{
+    ObjectCache<CommitInfo>& cache = current_repository().commits;
+    if (std::shared_ptr<const CommitInfo> cached = cache.find(commit_hash))
+    {
+        info = *cached;
+        return true;
+    }
+    trace::count(trace::kObjectsRead);
+    std::ifstream commit_file(object_path(commit_hash), std::ios::binary);
+    if (!commit_file.is_open())
+    {
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(commit_file)), std::istreambuf_iterator<char>());
+    parse_commit(content, info);
+    info.id = commit_hash;
+    cache.insert(commit_hash, std::make_shared<const CommitInfo>(info));
+    return true;
+}
+
+// Helper function to read the first line of HEAD: "ref: refs/heads/<branch>" or a detached commit id
+std::string read_head()
+{
+    std::string head_ref;
+    std::ifstream head_file(repo_path(".minigit/HEAD"));
+    std::getline(head_file, head_ref);
+    return head_ref;
+}
+
+// Helper function to resolve HEAD to the commit it points at (empty before the first commit)
+std::string resolve_head()
+{
+    std::string head_ref = read_head();
+    if (head_ref.rfind("ref: refs/heads/", 0) == 0)
+    {
+        return read_ref(head_ref.substr(16));
+    }
+    return head_ref;
+}
+
+const size_t BLOOM_BITS_PER_PATH = 10;
+const size_t BLOOM_HASH_COUNT = 7;
+const size_t BLOOM_MAX_PATHS = 512;
+
+// Helper function to derive the two base hashes used for double hashing a path into a Bloom filter
+std::pair<uint32_t, uint32_t> bloom_path_hashes(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ull; // FNV-1a offset basis
+    for (unsigned char c : path)
+    {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return {static_cast<uint32_t>(hash), static_cast<uint32_t>(hash >> 32) | 1};
+}
+
+// Helper function to test a path against a changed-path filter ("false" means definitely unchanged)
+bool bloom_may_contain(const CommitGraphEntry& entry, const std::string& path)
+{
+    if (entry.all_paths)
+    {
+        return true;
+    }
+    if (entry.changed_paths.empty())
+    {
+        return false;
+    }
+    size_t bit_count = entry.changed_paths.size() * 8;
+    auto [h1, h2] = bloom_path_hashes(path);
+    for (size_t i = 0; i < BLOOM_HASH_COUNT; i++)
+    {
+        size_t bit = (h1 + i * static_cast<uint64_t>(h2)) % bit_count;
+        if (!(static_cast<uint8_t>(entry.changed_paths[bit / 8]) & (1u << (bit % 8))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Builds the graph entry for a commit, diffing its files against its first parent's
+CommitGraphEntry build_commit_graph_entry(const CommitInfo& info,
+                                          const std::map<std::string, std::string>& files,
+                                          const std::map<std::string, std::string>& parent_files)
+{
+    CommitGraphEntry entry;
+    entry.timestamp = info.timestamp;
+    entry.parents = info.parents;
+
+    // Every changed file contributes itself and each of its parent directories
+    std::unordered_set<std::string> changed;
+    auto add_changed = [&](const std::string& path) {
+        for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+        {
+            changed.insert(path.substr(0, slash));
+        }
+        changed.insert(path);
+    };
+    for (const auto& [filename, file_sha1] : files)
+    {
+        auto it = parent_files.find(filename);
+        if (it == parent_files.end() || it->second != file_sha1)
+        {
+            add_changed(filename);
+        }
+    }
+    for (const auto& [filename, file_sha1] : parent_files)
+    {
+        if (files.find(filename) == files.end())
+        {
+            add_changed(filename);
+        }
+    }
+
+    if (changed.size() > BLOOM_MAX_PATHS)
+    {
+        entry.all_paths = true;
+        return entry;
+    }
+    if (changed.empty())
+    {
+        return entry;
+    }
+    size_t byte_count = std::max<size_t>(8, (changed.size() * BLOOM_BITS_PER_PATH + 7) / 8);
+    entry.changed_paths.assign(byte_count, '\0');
+    size_t bit_count = byte_count * 8;
+    for (const std::string& path : changed)
+    {
+        auto [h1, h2] = bloom_path_hashes(path);
+        for (size_t i = 0; i < BLOOM_HASH_COUNT; i++)
+        {
+            size_t bit = (h1 + i * static_cast<uint64_t>(h2)) % bit_count;
+            entry.changed_paths[bit / 8] = static_cast<char>(entry.changed_paths[bit / 8] | (1u << (bit % 8)));
+        }
+    }
+    return entry;
+}
+
+// Helper function to compute the checksum that closes every commit-graph line: FNV-1a over the rest of the
+// line, as 8 hex digits
+std::string commit_graph_checksum(const std::string& text)
+{
+    uint32_t hash = 2166136261u; // FNV-1a offset basis
+    for (unsigned char c : text)
+    {
+        hash = (hash ^ c) * 16777619u;
+    }
+    char digits[9];
+    std::snprintf(digits, sizeof(digits), "%08x", hash);
+    return digits;
+}
+
+// Helper function to parse one commit-graph line, "<commit> <unix-time> <parent,parent|-> <filter-hex|-|*> <checksum>";
+// returns false for a malformed line, including one torn by a crash in the middle of an append
+bool parse_commit_graph_line(const std::string& full_line, std::string& commit_hash, CommitGraphEntry& entry)
+{
+    size_t checksum_start = full_line.rfind(' ');
+    if (checksum_start == std::string::npos ||
+        full_line.compare(checksum_start + 1, std::string::npos, commit_graph_checksum(full_line.substr(0, checksum_start))) != 0)
+    {
+        return false;
+    }
+    std::string line = full_line.substr(0, checksum_start);
+    std::istringstream fields(line);
+    std::string parents, filter, extra;
+    long long timestamp = 0;
+    if (!(fields >> commit_hash >> timestamp >> parents >> filter) || (fields >> extra) || !is_object_id(commit_hash))
+    {
+        return false;
+    }
+    entry.timestamp = static_cast<std::time_t>(timestamp);
+    if (parents != "-")
+    {
+        std::stringstream parent_stream(parents);
+        std::string parent;
+        while (std::getline(parent_stream, parent, ','))
+        {
+            if (!is_object_id(parent))
+            {
+                return false;
+            }
+            entry.parents.push_back(parent);
+        }
+    }
+    entry.all_paths = filter == "*";
+    if (filter == "-" || filter == "*")
+    {
+        return true;
+    }
+    auto hex_value = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+    };
+    if (filter.size() % 2 != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < filter.size(); i += 2)
+    {
+        int high = hex_value(filter[i]), low = hex_value(filter[i + 1]);
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+        entry.changed_paths.push_back(static_cast<char>(high << 4 | low));
+    }
+    return true;
+}
+
+// Loads the commit graph on first use; missing or malformed lines are simply not cached, so a commit
+// whose line was damaged is read from its object instead
+std::unordered_map<std::string, CommitGraphEntry>& load_commit_graph()
+{
+    return current_repository().commit_graph.get([]() {
+        std::unordered_map<std::string, CommitGraphEntry> graph;
+        std::ifstream graph_file(repo_path(".minigit/info/commit-graph"));
+        std::string line;
+        while (std::getline(graph_file, line))
+        {
+            std::string commit_hash;
+            CommitGraphEntry entry;
+            if (parse_commit_graph_line(line, commit_hash, entry))
+            {
+                graph[commit_hash] = std::move(entry);
+            }
+        }
+        return graph;
+    });
+}
+
+// Helper function to format one commit-graph line, checksum and newline included
+std::string format_commit_graph_line(const std::string& commit_hash, const CommitGraphEntry& entry)
+{
+    const char hex_chars[] = "0123456789abcdef";
+    std::string line = commit_hash + " " + std::to_string(static_cast<long long>(entry.timestamp)) + " ";
+    std::string parents;
+    for (const std::string& parent : entry.parents)
+    {
+        parents += (parents.empty() ? "" : ",") + parent;
+    }
+    line += (parents.empty() ? "-" : parents) + " ";
+    if (entry.all_paths)
+    {
+        line += "*";
+    }
+    else if (entry.changed_paths.empty())
+    {
+        line += "-";
+    }
+    for (unsigned char byte : entry.changed_paths)
+    {
+        line.push_back(hex_chars[byte >> 4]);
+        line.push_back(hex_chars[byte & 0xF]);
+    }
+    return line + " " + commit_graph_checksum(line) + "\n";
+}
+
+// Appends entries to the on-disk commit graph, and to the in-memory copy when it is loaded. Only the new
+// lines are written, so recording a commit costs the same however long the history is; a line torn by a
+// crash fails its checksum and is ignored when the graph is loaded.
+bool append_commit_graph(const std::vector<std::pair<std::string, CommitGraphEntry>>& entries)
+{
+    if (entries.empty())
+    {
+        return true;
+    }
+    std::string graph_path = repo_path(".minigit/info/commit-graph");
+    // The graph must never describe commits that are not stored
+    if (!flush_object_writes())
+    {
+        error_output() << "Error: Not updating " << graph_path << " because objects it may refer to were not stored" << std::endl;
+        return false;
+    }
+    std::string lines;
+    for (const auto& [commit_hash, entry] : entries)
+    {
+        lines += format_commit_graph_line(commit_hash, entry);
+    }
+
+    fs::create_directories(repo_path(".minigit/info"));
+    int fd = ::open(graph_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        error_output() << "Error: Could not write " << graph_path << std::endl;
+        return false;
+    }
+    // A line torn by a crash is ended first, so that the new lines start on lines of their own
+    struct stat graph_stat;
+    char last = '\n';
+    bool created = ::fstat(fd, &graph_stat) != 0 || graph_stat.st_size == 0;
+    if (!created && ::pread(fd, &last, 1, graph_stat.st_size - 1) == 1 && last != '\n')
+    {
+        lines.insert(0, "\n");
+    }
+    bool durable = fsync_mode() != "none";
+    bool written = write_all(fd, lines.data(), lines.size()) && (!durable || ::fsync(fd) == 0);
+    ::close(fd);
+    if (!written)
+    {
+        error_output() << "Error: Could not write " << graph_path << std::endl;
+        return false;
+    }
+    if (durable && created)
+    {
+        fsync_directory(repo_path(".minigit/info"));
+    }
+
+    Repository::State& repository = current_repository();
+    if (repository.commit_graph.loaded)
+    {
+        std::unordered_map<std::string, CommitGraphEntry>& graph = load_commit_graph();
+        for (const auto& [commit_hash, entry] : entries)
+        {
+            graph[commit_hash] = entry;
+        }
+    }
+    return true;
+}
+
+// Records a freshly written commit in the commit graph. The graph only speeds up history walks, so a
+// failure here is reported but does not undo the commit.
+void record_commit_graph(const std::string& commit_hash)
+{
+    trace::Region region("record_commit_graph");
+    CommitInfo info;
+    if (!read_commit(commit_hash, info))
+    {
+        return;
+    }
+    std::map<std::string, std::string> parent_files;
+    if (!info.parents.empty())
+    {
+        parent_files = get_files_from_commit(info.parents[0]);
+    }
+    append_commit_graph({{commit_hash, build_commit_graph_entry(info, get_files_from_commit(commit_hash), parent_files)}});
+}
+
+// Helper function to list a commit's parents, from the commit graph when it has the commit
+std::vector<std::string> commit_parents(const std::string& commit_hash)
+{
+    std::unordered_map<std::string, CommitGraphEntry>& graph = load_commit_graph();
+    auto graph_it = graph.find(commit_hash);
+    if (graph_it != graph.end())
+    {
+        trace::count(trace::kCacheHits);
+        return graph_it->second.parents;
+    }
+    trace::count(trace::kCacheMisses);
+    CommitInfo info;
+    read_commit(commit_hash, info);
+    return info.parents;
+}
+
+// Helper function to find common ancestor: every ancestor of the first commit is collected, then the
+// second commit's history is searched breadth-first so the nearest shared commit wins
+std::string find_common_ancestor(const std::string& commit1_hash, const std::string& commit2_hash)
+{
+    trace::Region region("find_common_ancestor");
+    std::unordered_set<std::string> ancestors1;
+    std::vector<std::string> pending = {commit1_hash};
+    while (!pending.empty())
+    {
+        std::string current_commit = pending.back();
+        pending.pop_back();
+        if (current_commit.empty() || !ancestors1.insert(current_commit).second)
+        {
+            continue;
+        }
+        for (const std::string& parent : commit_parents(current_commit))
+        {
+            pending.push_back(parent);
+        }
+    }
+
+    std::unordered_set<std::string> seen = {commit2_hash};
+    std::queue<std::string> frontier;
+    frontier.push(commit2_hash);
+    while (!frontier.empty())
+    {
+        std::string current_commit = frontier.front();
+        frontier.pop();
+        if (ancestors1.count(current_commit))
+        {
+            return current_commit;
+        }
+        for (const std::string& parent : commit_parents(current_commit))
+        {
+            if (seen.insert(parent).second)
+            {
+                frontier.push(parent);
+            }
+        }
+    }
+    return "";
+}
+
+// Initializes a new MiniGit repository whose objects are named by the given hash algorithm
+// (empty for the default). The algorithm is fixed for the life of the repository.
+bool init(const std::string& hash_name, bool& created)
+{
+    bool existing = fs::exists(repo_path(".minigit"));
+    if (existing && !hash_name.empty() && hash_name != read_config("core.hash", "sha1"))
+    {
+        error_output() << "Error: Repository already uses " << read_config("core.hash", "sha1")
+                       << " object ids; the hash algorithm cannot be changed after init" << std::endl;
+        return false;
+    }
+
+    // Create .minigit directory (and the repository root) if it doesn't exist
+    created = !existing;
+    if (!existing)
+    {
+        fs::create_directories(repo_path(".minigit"));
+    }
+
+    // Create necessary subdirectories and files
+    if (!fs::exists(repo_path(".minigit/objects")))
+        fs::create_directory(repo_path(".minigit/objects"));
+    if (!fs::exists(repo_path(".minigit/refs")))
+        fs::create_directory(repo_path(".minigit/refs"));
+    if (!fs::exists(repo_path(".minigit/refs/heads"))) // Ensure this is created before HEAD is written
+        fs::create_directory(repo_path(".minigit/refs/heads"));
+    if (!fs::exists(repo_path(".minigit/HEAD")))
+    {
+        write_file_atomic(repo_path(".minigit/HEAD"), "ref: refs/heads/master\n");
+    }
+    if (!fs::exists(repo_path(".minigit/index")))
+    {
+        write_file_atomic(repo_path(".minigit/index"), "");
+    }
+    if (!existing)
+    {
+        return write_config("core.hash", hash_name.empty() ? "sha1" : hash_name);
+    }
+    return true;
+}
+
+// Adds files to the staging area.
+std::vector<AddedFile> add(const std::vector<std::string>& filenames)
+{
+    // Large files are split into chunks; only chunks not already in the store are written.
+    // Everything else is read, hashed and stored in batches through the I/O engine.
+    uint64_t threshold = chunk_threshold();
+    std::vector<std::string> file_sha1s(filenames.size());
+    std::vector<size_t> plain_files;
+    std::vector<uint64_t> plain_sizes;
+    {
+        trace::Region region("stat_files");
+        trace::count(trace::kFilesStated, filenames.size());
+        for (size_t i = 0; i < filenames.size(); i++)
+        {
+            std::error_code ec;
+            uint64_t size = fs::file_size(repo_path(filenames[i]), ec);
+            if (ec)
+            {
+                continue;
+            }
+            if (threshold != 0 && size >= threshold)
+            {
+                file_sha1s[i] = store_chunked_file(repo_path(filenames[i]));
+            }
+            else
+            {
+                plain_files.push_back(i);
+                plain_sizes.push_back(size);
+            }
+        }
+    }
+
+    for (size_t first = 0, last = 0; first < plain_files.size(); first = last)
+    {
+        last = io_batch_end(first, plain_files.size(), [&](size_t i) { return plain_sizes[i]; });
+        std::vector<io::ReadRequest> reads(last - first);
+        for (size_t i = first; i < last; i++)
+        {
+            reads[i - first].path = repo_path(filenames[plain_files[i]]);
+        }
+        {
+            trace::Region region("read_files");
+            io::read_files(reads);
+        }
+        {
+            trace::Region region("hash");
+            parallel_for(reads.size(), [&](size_t i) {
+                if (reads[i].ok)
+                {
+                    file_sha1s[plain_files[first + i]] = calculate_hash(reads[i].data);
+                }
+            });
+        }
+
+        // Store blobs in .minigit/objects/
+        std::vector<std::pair<std::string, const std::string*>> objects;
+        for (size_t i = 0; i < reads.size(); i++)
+        {
+            if (reads[i].ok)
+            {
+                objects.push_back({file_sha1s[plain_files[first + i]], &reads[i].data});
+            }
+        }
+        write_objects(objects);
+    }
+
+    std::vector<AddedFile> added(filenames.size());
+    std::string index_entries;
+    for (size_t i = 0; i < filenames.size(); i++)
+    {
+        added[i].path = filenames[i];
+        if (file_sha1s[i].empty())
+        {
+            added[i].error = fs::exists(repo_path(filenames[i])) ? "Could not hash " + filenames[i] : "file not found " + filenames[i];
+            error_output() << "Error: " << added[i].error << std::endl;
+            continue;
+        }
+        added[i].id = file_sha1s[i];
+        index_entries += file_sha1s[i] + " " + filenames[i] + "\n";
+    }
+
+    // Update index file; the rewrite flushes the new blobs before the index can refer to them
+    if (!index_entries.empty() &&
+        !write_file_atomic(repo_path(".minigit/index"), read_file_content(repo_path(".minigit/index")) + index_entries))
+    {
+        for (AddedFile& file : added)
+        {
+            file.id.clear();
+        }
+    }
+    return added;
+}
+
+// Records changes to the repository with a message.
+CommitResult commit(const std::string& message)
+{
+    // Read index file to get staged files
+    std::ifstream index_file(repo_path(".minigit/index"));
+    std::string line;
+    std::string commit_content = "tree "; // Placeholder for tree hash
+    std::string parent_commit_hash = "";
+
+    // Get parent commit hash from HEAD
+    std::string head_ref = read_head();
+
+    std::string current_branch_name = "";
+    if (head_ref.rfind("ref: refs/heads/", 0) == 0) // If HEAD points to a ref (branch)
+    {
+        current_branch_name = head_ref.substr(16);
+        parent_commit_hash = read_ref(current_branch_name);
+    }
+    else // If HEAD points directly to a commit (detached HEAD)
+    {
+        parent_commit_hash = head_ref;
+    }
+
+    if (!parent_commit_hash.empty())
+    {
+        commit_content += "\nparent " + parent_commit_hash;
+    }
+
+    // Get current timestamp
+    auto now = std::chrono::system_clock::now();
+    std::time_t current_time = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&current_time), "%c");
+    commit_content += "\nauthor Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
+    commit_content += "\ncommitter Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
+    commit_content += "\n\n" + message + "\n";
+
+    // The snapshot is the parent's files with the staged files applied on top
+    // (simplified - in a real Git, this would involve creating a tree object)
+    std::map<std::string, std::string> files;
+    if (!parent_commit_hash.empty())
+    {
+        files = get_files_from_commit(parent_commit_hash);
+    }
+    while (std::getline(index_file, line))
+    {
+        size_t space = line.find(' ');
+        if (space != std::string::npos)
+        {
+            files[line.substr(space + 1)] = line.substr(0, space);
+        }
+    }
+    index_file.close();
+    for (const auto& [filename, file_sha1] : files)
+    {
+        commit_content += file_sha1 + " " + filename + "\n";
+    }
+
+    // Calculate commit hash
+    std::string commit_sha1 = calculate_hash(commit_content);
+
+    // Save commit object
+    write_object(commit_sha1, commit_content);
+    record_commit_graph(commit_sha1);
+
+    // Update branch pointer and HEAD; the branch is written first so HEAD never names a missing commit
+    if (current_branch_name.empty())
+    {
+        // If HEAD was detached or initial commit, set it to master branch
+        current_branch_name = "master";
+    }
+    CommitResult result;
+    result.ok = write_ref(current_branch_name, commit_sha1) &&
+                write_file_atomic(repo_path(".minigit/HEAD"), "ref: refs/heads/" + current_branch_name + "\n") &&
+                write_file_atomic(repo_path(".minigit/index"), ""); // Clear index after commit
+    result.id = commit_sha1;
+    result.branch = current_branch_name;
+    return result;
+}
+
+// Helper function to fingerprint the entries of a commit that fall under the given paths
+std::string path_fingerprint(const std::string& commit_hash, const std::vector<std::string>& paths)
+{
+    std::string fingerprint;
+    for (const auto& [filename, file_sha1] : get_files_from_commit(commit_hash))
+    {
+        for (const std::string& path : paths)
+        {
+            if (filename == path || (filename.size() > path.size() && filename.rfind(path, 0) == 0 && filename[path.size()] == '/'))
+            {
+                fingerprint += file_sha1 + " " + filename + "\n";
+                break;
+            }
+        }
+    }
+    return fingerprint;
+}
+
+// Collects the commit history, newest first.
+std::vector<CommitInfo> log(const LogOptions& options)
+{
+    std::vector<CommitInfo> commits;
+    std::string head_hash = resolve_head();
+    if (head_hash.empty())
+    {
+        return commits;
+    }
+
+    // Paths are compared with file entries and filter keys, which never have a leading "./" or a trailing '/';
+    // like sparse checkout patterns, both are dropped, and a path naming the whole tree ("." or "./") drops
+    // the path limit altogether
+    std::vector<std::string> paths;
+    for (std::string path : options.paths)
+    {
+        while (path.rfind("./", 0) == 0)
+        {
+            path.erase(0, 2);
+        }
+        while (!path.empty() && path.back() == '/')
+        {
+            path.pop_back();
+        }
+        if (path.empty() || path == ".")
+        {
+            paths.clear();
+            break;
+        }
+        paths.push_back(path);
+    }
+
+    // Path fingerprints are cached until both a commit and its children have been examined
+    std::unordered_map<std::string, std::string> fingerprints;
+    auto fingerprint_of = [&](const std::string& commit_hash) -> const std::string& {
+        auto it = fingerprints.find(commit_hash);
+        if (it == fingerprints.end())
+        {
+            it = fingerprints.emplace(commit_hash, path_fingerprint(commit_hash, paths)).first;
+        }
+        return it->second;
+    };
+
+    // Newest commit first, and commits with the same time in the order they were queued. Times only have
+    // one-second resolution, so a parent can share its child's time; it is then held back until every queued
+    // child with that time has come out. Queued commits keep their parsed headers so each object is read only once.
+    struct QueueEntry
+    {
+        std::time_t timestamp;
+        uint64_t sequence;
+        std::string commit_hash;
+
+        bool operator<(const QueueEntry& other) const
+        {
+            return timestamp != other.timestamp ? timestamp < other.timestamp : sequence > other.sequence;
+        }
+    };
+    std::priority_queue<QueueEntry> queue;
+    uint64_t next_sequence = 0;
+    std::unordered_map<std::string, CommitInfo> queued;
+    // (parent, child time) -> queued children with that time
+    std::map<std::pair<std::string, std::time_t>, size_t> waiting_children;
+    auto walked_parents = [&](const CommitInfo& info) {
+        return options.first_parent ? std::min<size_t>(1, info.parents.size()) : info.parents.size();
+    };
+    std::unordered_set<std::string> seen;
+    // Commits present in the commit graph are walked without opening their objects
+    std::unordered_map<std::string, CommitGraphEntry>& graph = load_commit_graph();
+    auto enqueue = [&](const std::string& commit_hash) {
+        CommitInfo info;
+        auto graph_it = graph.find(commit_hash);
+        if (graph_it != graph.end())
+        {
+            trace::count(trace::kCacheHits);
+            info.parents = graph_it->second.parents;
+            info.timestamp = graph_it->second.timestamp;
+        }
+        else
+        {
+            trace::count(trace::kCacheMisses);
+            if (!read_commit(commit_hash, info))
+            {
+                error_output() << "Error: Could not read commit " << commit_hash << std::endl;
+                return;
+            }
+        }
+        for (size_t i = 0; i < walked_parents(info); i++)
+        {
+            waiting_children[{info.parents[i], info.timestamp}]++;
+        }
+        queue.push({info.timestamp, next_sequence++, commit_hash});
+        queued.emplace(commit_hash, std::move(info));
+    };
+    seen.insert(head_hash);
+    enqueue(head_hash);
+
+    while (!queue.empty() && (options.max_count == 0 || commits.size() < options.max_count))
+    {
+        QueueEntry entry = queue.top();
+        queue.pop();
+        auto waiting_it = waiting_children.find({entry.commit_hash, entry.timestamp});
+        if (waiting_it != waiting_children.end())
+        {
+            entry.sequence = next_sequence++;
+            queue.push(std::move(entry));
+            continue;
+        }
+        std::string commit_hash = std::move(entry.commit_hash);
+        auto queued_it = queued.find(commit_hash);
+        CommitInfo info = std::move(queued_it->second);
+        queued.erase(queued_it);
+        for (size_t i = 0; i < walked_parents(info); i++)
+        {
+            auto child_it = waiting_children.find({info.parents[i], info.timestamp});
+            if (--child_it->second == 0)
+            {
+                waiting_children.erase(child_it);
+            }
+        }
+
+        // Commits come out in date order, so everything left is older than --since
+        if (options.since != 0 && info.timestamp < options.since)
+        {
+            break;
+        }
+
+        size_t parent_count = walked_parents(info);
+        for (size_t i = 0; i < parent_count; i++)
+        {
+            if (seen.insert(info.parents[i]).second)
+            {
+                enqueue(info.parents[i]);
+            }
+        }
+
+        bool selected = options.until == 0 || info.timestamp <= options.until;
+        auto graph_it = graph.find(commit_hash);
+        if (selected && !paths.empty() && graph_it != graph.end())
+        {
+            // A commit whose filter rules out every path matches its first parent there and is skipped unread
+            selected = std::any_of(paths.begin(), paths.end(), [&](const std::string& path) {
+                return bloom_may_contain(graph_it->second, path);
+            });
+        }
+        if (selected && !paths.empty())
+        {
+            // A commit changes the paths when it differs from every parent it is compared against
+            const std::string& fingerprint = fingerprint_of(commit_hash);
+            if (parent_count == 0)
+            {
+                selected = !fingerprint.empty();
+            }
+            for (size_t i = 0; i < parent_count && selected; i++)
+            {
+                selected = fingerprint_of(info.parents[i]) != fingerprint;
+            }
+            fingerprints.erase(commit_hash);
+        }
+        if (!selected)
+        {
+            continue;
+        }
+        if (info.committer.empty())
+        {
+            // Only the graph entry was loaded so far; the message and identities live in the object
+            info = CommitInfo();
+            read_commit(commit_hash, info);
+        }
+
+        info.id = commit_hash;
+        commits.push_back(std::move(info));
+    }
+    return commits;
+}
+
+// Creates a new branch at the commit HEAD points to.
+bool branch(const std::string& branch_name)
+{
+    // If HEAD is a symbolic ref, resolve it to the actual commit hash
+    std::string head_commit_hash = resolve_head();
+
+    if (ref_exists(branch_name))
+    {
+        error_output() << "Error: A branch named \"" << branch_name << "\" already exists." << std::endl;
+        return false;
+    }
+
+    return write_ref(branch_name, head_commit_hash);
+}
+
+// Switches to a specified branch or commit, optionally verifying blob contents first.
+bool checkout(const std::string& target, bool verify)
+{
+    std::string commit_hash_to_checkout;
+    std::string head_content;
+
+    // Check if target is a branch name
+    commit_hash_to_checkout = read_ref(target);
+    if (!commit_hash_to_checkout.empty())
+    {
+        head_content = "ref: refs/heads/" + target;
+    }
+    else // Assume target is a commit hash
+    {
+        if (!object_exists(target))
+        {
+            error_output() << "Error: Branch or commit \"" << target << "\" not found." << std::endl;
+            return false;
+        }
+        commit_hash_to_checkout = target;
+        head_content = target;
+    }
+
+    // Read commit content to restore files (simplified - in a real Git, this would involve reading tree objects)
+    // Only the sparse checkout set is materialized (everything when sparse checkout is off)
+    std::map<std::string, std::string> files_in_commit = load_sparse_checkout().filter(get_files_from_commit(commit_hash_to_checkout));
+
+    // In verify mode every blob is rehashed before anything on disk changes
+    if (verify)
+    {
+        trace::Region region("verify_objects");
+        std::vector<std::pair<std::string, std::string>> entries(files_in_commit.begin(), files_in_commit.end());
+        std::vector<char> intact(entries.size());
+        for (size_t first = 0, last = 0; first < entries.size(); first = last)
+        {
+            last = io_batch_end(first, entries.size(), [&](size_t i) { return size_on_disk(object_path(entries[i].second)); });
+            std::vector<io::ReadRequest> reads(last - first);
+            for (size_t i = 0; i < reads.size(); i++)
+            {
+                reads[i].path = object_path(entries[first + i].second);
+            }
+            io::read_files(reads);
+            trace::count(trace::kObjectsRead, reads.size());
+            parallel_for(reads.size(), [&](size_t i) {
+                const std::string& blob_sha1 = entries[first + i].second;
+                bool ok = reads[i].ok && calculate_hash(reads[i].data) == blob_sha1;
+                ChunkManifest manifest;
+                if (ok && reads[i].data.rfind(CHUNK_MANIFEST_HEADER, 0) == 0 && read_chunk_manifest(blob_sha1, manifest))
+                {
+                    std::string content;
+                    for (const auto& [chunk_hash, length] : manifest.chunks)
+                    {
+                        ok = ok && read_object(chunk_hash, content) && calculate_hash(content) == chunk_hash;
+                    }
+                }
+                intact[first + i] = ok;
+            });
+        }
+        bool all_intact = true;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (!intact[i])
+            {
+                error_output() << "Error: Object " << entries[i].second << " for " << entries[i].first << " is missing or corrupt." << std::endl;
+                all_intact = false;
+            }
+        }
+        if (!all_intact)
+        {
+            error_output() << "Checkout aborted; working tree left unchanged." << std::endl;
+            return false;
+        }
+    }
+
+    // Update HEAD
+    if (!write_file_atomic(repo_path(".minigit/HEAD"), head_content + "\n"))
+    {
+        return false;
+    }
+
+    // Clear working directory (except .minigit)
+    {
+        trace::Region region("clear_working_tree");
+        for (const auto& entry : fs::directory_iterator(repo_path(".")))
+        {
+            if (entry.path().filename() != ".minigit")
+            {
+                fs::remove_all(entry.path());
+            }
+        }
+    }
+
+    // Restore files from commit
+    if (!restore_blobs(files_in_commit))
+    {
+        error_output() << "Error: Switched to " << target << ", but some of its files could not be restored." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Merges a specified branch into the current branch.
+MergeResult merge(const std::string& branch_to_merge)
+{
+    MergeResult result;
+    std::string current_branch_hash;
+    std::string head_ref = read_head();
+
+    if (head_ref.rfind("ref: refs/heads/", 0) == 0)
+    {
+        result.branch = head_ref.substr(16);
+        current_branch_hash = read_ref(result.branch);
+    }
+    else
+    {
+        error_output() << "Error: Detached HEAD. Cannot merge." << std::endl;
+        result.ok = false;
+        return result;
+    }
+
+    std::string merge_branch_hash = read_ref(branch_to_merge);
+    if (merge_branch_hash.empty())
+    {
+        error_output() << "Error: Branch \"" << branch_to_merge << "\" not found." << std::endl;
+        result.ok = false;
+        return result;
+    }
+
+    if (current_branch_hash == merge_branch_hash)
+    {
+        result.up_to_date = true;
+        return result;
+    }
+
+    std::string common_ancestor_hash = find_common_ancestor(current_branch_hash, merge_branch_hash);
+
+    std::map<std::string, std::string> current_files = get_files_from_commit(current_branch_hash);
+    std::map<std::string, std::string> merge_files = get_files_from_commit(merge_branch_hash);
+    std::map<std::string, std::string> ancestor_files = get_files_from_commit(common_ancestor_hash);
+
+    std::string merge_commit_message = "Merge branch \"" + branch_to_merge + "\"";
+
+    // Files outside the sparse checkout are merged in the file list only and never touch the working tree
+    const SparseCheckout& sparse = load_sparse_checkout();
+    std::map<std::string, std::string> merged_files = current_files;
+    std::map<std::string, std::string> files_to_restore;
+
+    // Apply changes from merge_files to current_files
+    for (const auto& [filename, merge_sha1] : merge_files)
+    {
+        std::string current_sha1 = current_files[filename];
+        std::string ancestor_sha1 = ancestor_files[filename];
+
+        if (current_sha1 == merge_sha1) {
+            // No change or same change in both branches
+            continue;
+        } else if (current_sha1 == ancestor_sha1) {
+            // File changed in merge branch, not in current branch
+            // Copy file from merge branch to working directory and add to index
+            merged_files[filename] = merge_sha1;
+            if (sparse.includes(filename))
+            {
+                files_to_restore[filename] = merge_sha1;
+            }
+        } else if (merge_sha1 == ancestor_sha1) {
+            // File changed in current branch, not in merge branch
+            // Do nothing, current version is fine
+        } else {
+            // Conflict: file changed in both branches differently
+            error_output() << "Conflict in file: " << filename << std::endl;
+            result.conflicts.push_back(filename);
+            // For simplicity, we'll just leave the current version and report conflict
+            // In a real Git, this would involve conflict markers in the file
+        }
+    }
+
+    // Restore the files taken from the merge branch in one batch and add them to the index
+    if (!files_to_restore.empty())
+    {
+        if (!restore_blobs(files_to_restore))
+        {
+            // Staging now would record the current branch's versions of the files that were not restored
+            error_output() << "Merge aborted; nothing was staged or committed." << std::endl;
+            result.ok = false;
+            return result;
+        }
+        std::vector<std::string> restored_paths;
+        for (const auto& [filename, merge_sha1] : files_to_restore)
+        {
+            restored_paths.push_back(filename);
+        }
+        for (const AddedFile& added : add(restored_paths))
+        {
+            if (!added.id.empty())
+            {
+                result.updated[added.path] = added.id;
+            }
+        }
+    }
+
+    // Handle files deleted in merge branch but present in current branch
+    for (const auto& [filename, current_sha1] : current_files)
+    {
+        if (merge_files.find(filename) == merge_files.end() && ancestor_files.find(filename) != ancestor_files.end())
+        {
+            // File deleted in merge branch, but present in ancestor and current
+            // For simplicity, we'll delete it from working directory and index
+            merged_files.erase(filename);
+            if (sparse.includes(filename))
+            {
+                fs::remove(repo_path(filename));
+            }
+            // TODO: Remove from index
+        }
+    }
+
+    if (!result.conflicts.empty())
+    {
+        error_output() << "Merge failed due to conflicts. Please resolve them manually." << std::endl;
+        result.ok = false;
+        return result;
+    }
+
+    // Create merge commit
+    std::string commit_content = "tree "; // Placeholder for tree hash
+    commit_content += "\nparent " + current_branch_hash;
+    commit_content += "\nparent " + merge_branch_hash;
+
+    auto now = std::chrono::system_clock::now();
+    std::time_t current_time = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&current_time), "%c");
+    commit_content += "\nauthor Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
+    commit_content += "\ncommitter Samuel Godad and Firamit Megersa <godadsamuel@gmail.com> " + ss.str();
+    commit_content += "\n\n" + merge_commit_message + "\n";
+
+    // Tracked files in the sparse set are taken from the working directory, the rest from the merge result
+    {
+        trace::Region region("working_tree_scan");
+        for (const auto& [filename, merged_sha1] : merged_files)
+        {
+            if (!sparse.includes(filename))
+            {
+                commit_content += merged_sha1 + " " + filename + "\n";
+            }
+            else if (fs::is_regular_file(repo_path(filename)))
+            {
+                trace::count(trace::kFilesStated);
+                commit_content += hash_working_file(repo_path(filename)) + " " + filename + "\n";
+            }
+        }
+
+        // Add untracked files from the top of the working directory as well (simplified)
+        for (const auto& entry : fs::directory_iterator(repo_path(".")))
+        {
+            std::string filename = entry.path().filename().string();
+            if (filename != ".minigit" && entry.is_regular_file() && merged_files.count(filename) == 0 && sparse.includes(filename))
+            {
+                trace::count(trace::kFilesStated);
+                std::string file_sha1 = hash_working_file(repo_path(filename));
+                if (!file_sha1.empty())
+                {
+                    commit_content += file_sha1 + " " + filename + "\n";
+                }
+            }
+        }
+    }
+
+    std::string merge_commit_sha1 = calculate_hash(commit_content);
+
+    write_object(merge_commit_sha1, commit_content);
+    record_commit_graph(merge_commit_sha1);
+
+    // Update HEAD and current branch pointer
+    result.ok = write_ref(result.branch, merge_commit_sha1) &&
+                write_file_atomic(repo_path(".minigit/HEAD"), "ref: refs/heads/" + result.branch + "\n");
+    result.commit = merge_commit_sha1;
+    return result;
+}
+
+// Shows the differences between two files: lines are matched greedily, and the resulting script is cut
+// into hunks of changed lines with up to `context` unchanged lines around them.
+DiffResult diff_files(const std::string& file1_path, const std::string& file2_path, size_t context) {
+    DiffResult result;
+    auto read_lines = [&](const std::string& path, std::vector<std::string>& lines) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            result.ok = false;
+            result.error += "Error: Could not open file " + path + "\n";
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line);
+        }
+    };
+    std::vector<std::string> lines1, lines2;
+    read_lines(file1_path, lines1);
+    read_lines(file2_path, lines2);
+    if (!result.ok) {
+        return result;
+    }
+
+    std::vector<DiffLine> script;
+    size_t i = 0, j = 0;
+    while (i < lines1.size() || j < lines2.size()) {
+        if (i < lines1.size() && j < lines2.size()) {
+            if (lines1[i] == lines2[j]) {
+                script.push_back({' ', lines1[i]});
+                i++;
+                j++;
+            } else {
+                // Find if line from lines1 exists later in lines2
+                size_t temp_j = j;
+                bool found_in_lines2 = false;
+                while (temp_j < lines2.size()) {
+                    if (lines1[i] == lines2[temp_j]) {
+                        found_in_lines2 = true;
+                        break;
+                    }
+                    temp_j++;
+                }
+
+                // Find if line from lines2 exists later in lines1
+                size_t temp_i = i;
+                bool found_in_lines1 = false;
+                while (temp_i < lines1.size()) {
+                    if (lines2[j] == lines1[temp_i]) {
+                        found_in_lines1 = true;
+                        break;
+                    }
+                    temp_i++;
+                }
+
+                if (found_in_lines2 && !found_in_lines1) {
+                    script.push_back({'+', lines2[j]});
+                    j++;
+                } else if (!found_in_lines2 && found_in_lines1) {
+                    script.push_back({'-', lines1[i]});
+                    i++;
+                } else {
+                    // Both changed or both new/deleted, report both as changes
+                    script.push_back({'-', lines1[i]});
+                    script.push_back({'+', lines2[j]});
+                    i++;
+                    j++;
+                }
+            }
+        } else if (i < lines1.size()) {
+            script.push_back({'-', lines1[i]});
+            i++;
+        } else if (j < lines2.size()) {
+            script.push_back({'+', lines2[j]});
+            j++;
+        }
+    }
+
+    // Mark the lines that belong to a hunk: every change plus its context
+    std::vector<char> in_hunk(script.size(), context == WHOLE_FILE);
+    for (size_t k = 0; k < script.size() && context != WHOLE_FILE; k++) {
+        if (script[k].kind != ' ') {
+            size_t first = k > context ? k - context : 0;
+            size_t last = std::min(script.size() - 1, k + context);
+            std::fill(in_hunk.begin() + static_cast<std::ptrdiff_t>(first), in_hunk.begin() + static_cast<std::ptrdiff_t>(last) + 1, 1);
+        }
+    }
+
+    size_t old_line = 0, new_line = 0; // Lines of each file consumed so far
+    for (size_t k = 0; k < script.size(); k++) {
+        char kind = script[k].kind;
+        if (in_hunk[k]) {
+            if (k == 0 || !in_hunk[k - 1]) {
+                result.hunks.emplace_back();
+                result.hunks.back().old_start = old_line + 1;
+                result.hunks.back().new_start = new_line + 1;
+            }
+            DiffHunk& hunk = result.hunks.back();
+            hunk.old_count += kind != '+';
+            hunk.new_count += kind != '-';
+            hunk.lines.push_back(std::move(script[k]));
+        }
+        old_line += kind != '+';
+        new_line += kind != '-';
+    }
+    // A hunk that only inserts (or only removes) names the line it follows, as unified diffs do
+    for (DiffHunk& hunk : result.hunks) {
+        hunk.old_start -= hunk.old_count == 0;
+        hunk.new_start -= hunk.new_count == 0;
+    }
+    return result;
+}
+
+// Helper function to name the branch HEAD points at (empty when detached)
+std::string current_branch()
+{
+    std::string head_ref = read_head();
+    return head_ref.rfind("ref: refs/heads/", 0) == 0 ? head_ref.substr(16) : "";
+}
+
+// Lists all branches and marks the current branch
+std::vector<BranchInfo> list_branches()
+{
+    std::string current_branch_name = current_branch();
+    std::vector<BranchInfo> branches;
+    for (const auto& [branch_name, commit_hash] : list_refs()) {
+        branches.push_back({branch_name, commit_hash, branch_name == current_branch_name});
+    }
+    return branches;
+}
+
+// Collects the current branch, sparse checkout state and staged files
+StatusResult status()
+{
+    StatusResult result;
+    result.branch = current_branch();
+    result.head = resolve_head();
+
+    const SparseCheckout& sparse = load_sparse_checkout();
+    result.sparse_checkout = sparse.enabled;
+    result.sparse_patterns = sparse.pattern_count;
+
+    std::ifstream index_file(repo_path(".minigit/index"));
+    std::string line;
+    while (std::getline(index_file, line)) {
+        size_t space_pos = line.find(" ");
+        if (space_pos != std::string::npos) {
+            std::string filename = line.substr(space_pos + 1);
+            result.staged.push_back({filename, line.substr(0, space_pos), sparse.includes(filename)});
+        }
+    }
+    return result;
+}
+
+// Manages the sparse checkout patterns and brings the working tree in line with them.
+// Subcommands: set <pattern>..., add <pattern>..., disable.
+bool sparse_checkout(const std::string& subcommand, const std::vector<std::string>& patterns)
+{
+    std::string patterns_path = repo_path(".minigit/info/sparse-checkout");
+    std::map<std::string, std::string> head_files = get_files_from_commit(resolve_head());
+    const SparseCheckout& old_sparse = load_sparse_checkout();
+    std::map<std::string, std::string> previously_included = old_sparse.filter(head_files);
+
+    SparseCheckout new_sparse;
+    if (subcommand == "set" || subcommand == "add")
+    {
+        std::string content = subcommand == "add" ? read_file_content(patterns_path) : "";
+        for (const std::string& pattern : patterns)
+        {
+            content += pattern + "\n";
+        }
+        fs::create_directories(repo_path(".minigit/info"));
+        if (!write_file_atomic(patterns_path, content))
+        {
+            return false;
+        }
+        new_sparse.enabled = true;
+        std::stringstream pattern_lines(content);
+        std::string line;
+        while (std::getline(pattern_lines, line))
+        {
+            if (!line.empty() && line[0] != '#')
+            {
+                new_sparse.add_pattern(line);
+            }
+        }
+    }
+    else if (subcommand == "disable")
+    {
+        fs::remove(patterns_path);
+    }
+    else
+    {
+        error_output() << "Error: Unknown sparse-checkout subcommand \"" << subcommand << "\"" << std::endl;
+        return false;
+    }
+    current_repository().sparse_checkout.reset();
+
+    // Only files entering or leaving the sparse set are touched
+    std::map<std::string, std::string> now_included = new_sparse.filter(head_files);
+    std::map<std::string, std::string> entering;
+    size_t removed = 0;
+    for (const auto& [filename, file_sha1] : now_included)
+    {
+        if (previously_included.count(filename) == 0 || !fs::exists(repo_path(filename)))
+        {
+            entering[filename] = file_sha1;
+        }
+    }
+    bool restored = restore_blobs(entering);
+    size_t materialized = entering.size();
+    std::set<std::string> emptied_directories;
+    for (const auto& [filename, file_sha1] : previously_included)
+    {
+        if (now_included.count(filename) == 0 && fs::remove(repo_path(filename)))
+        {
+            removed++;
+            for (size_t slash = filename.rfind('/'); slash != std::string::npos && slash > 0; slash = filename.rfind('/', slash - 1))
+            {
+                emptied_directories.insert(filename.substr(0, slash));
+            }
+        }
+    }
+    // Directories the removed files leave empty go too; a subdirectory sorts after its parent, so walking the
+    // set backwards empties children first. Directories still holding anything are kept by remove() itself.
+    for (auto it = emptied_directories.rbegin(); it != emptied_directories.rend(); ++it)
+    {
+        std::error_code ec;
+        fs::remove(repo_path(*it), ec);
+    }
+    progress_output() << "Sparse checkout updated: " << now_included.size() << " of " << head_files.size()
+                      << " files present (" << materialized << " added, " << removed << " removed)" << std::endl;
+    return restored;
+}
+
+// Computes changed-path filters for every reachable commit that is missing from the commit graph and
+// rewrites the graph file atomically. Returns false when a reachable commit could not be read.
+bool write_commit_graph()
+{
+    std::unordered_map<std::string, CommitGraphEntry>& graph = load_commit_graph();
+
+    std::vector<std::string> pending;
+    std::unordered_set<std::string> seen;
+    auto visit = [&](const std::string& commit_hash) {
+        if (!commit_hash.empty() && seen.insert(commit_hash).second)
+        {
+            pending.push_back(commit_hash);
+        }
+    };
+    visit(resolve_head());
+    for (const auto& [branch_name, tip] : list_refs())
+    {
+        visit(tip);
+    }
+
+    std::vector<std::string> missing;
+    bool complete = true;
+    while (!pending.empty())
+    {
+        std::string commit_hash = pending.back();
+        pending.pop_back();
+        auto graph_it = graph.find(commit_hash);
+        CommitInfo info;
+        if (graph_it != graph.end())
+        {
+            info.parents = graph_it->second.parents;
+        }
+        else if (read_commit(commit_hash, info))
+        {
+            missing.push_back(commit_hash);
+        }
+        else
+        {
+            error_output() << "Error: Could not read commit " << commit_hash << std::endl;
+            complete = false;
+        }
+        for (const std::string& parent : info.parents)
+        {
+            visit(parent);
+        }
+    }
+
+    std::vector<std::pair<std::string, CommitGraphEntry>> entries(missing.size());
+    parallel_for(missing.size(), [&](size_t i) {
+        CommitInfo info;
+        read_commit(missing[i], info);
+        std::map<std::string, std::string> parent_files;
+        if (!info.parents.empty())
+        {
+            parent_files = get_files_from_commit(info.parents[0]);
+        }
+        entries[i] = {missing[i], build_commit_graph_entry(info, get_files_from_commit(missing[i]), parent_files)};
+    });
+    // The file is rewritten whole here, which also drops torn and duplicate lines left by appends
+    for (auto& [commit_hash, entry] : entries)
+    {
+        graph[commit_hash] = std::move(entry);
+    }
+    std::vector<std::pair<std::time_t, const std::string*>> order;
+    order.reserve(graph.size());
+    for (const auto& [commit_hash, entry] : graph)
+    {
+        order.push_back({entry.timestamp, &commit_hash});
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+    });
+    std::string content;
+    for (const auto& [timestamp, commit_hash] : order)
+    {
+        content += format_commit_graph_line(*commit_hash, graph[*commit_hash]);
+    }
+    fs::create_directories(repo_path(".minigit/info"));
+    if (!write_file_atomic(repo_path(".minigit/info/commit-graph"), content))
+    {
+        current_repository().commit_graph.reset();
+        complete = false;
+    }
+
+    progress_output() << "Computed changed-path filters for " << missing.size() << " commits ("
+                      << seen.size() - missing.size() << " already present)" << std::endl;
+    return complete;
+}
+
+// Concurrent "visited" bitmap over the sorted list of loose object ids
+struct ObjectMarks
+{
+    std::vector<std::string> ids;
+    std::vector<std::atomic<uint64_t>> words;
+
+    explicit ObjectMarks(std::vector<std::string> sorted_ids)
+        : ids(std::move(sorted_ids)), words((ids.size() + 63) / 64)
+    {
+    }
+
+    // Returns the position of an object id, or ids.size() when it is not stored
+    size_t find(const std::string& object_hash) const
+    {
+        auto it = std::lower_bound(ids.begin(), ids.end(), object_hash);
+        return it != ids.end() && *it == object_hash ? static_cast<size_t>(it - ids.begin()) : ids.size();
+    }
+
+    // Sets the bit for an object and reports whether this call was the one that set it
+    bool mark(size_t index)
+    {
+        uint64_t bit = 1ull << (index % 64);
+        return !(words[index / 64].fetch_or(bit) & bit);
+    }
+
+    bool marked(size_t index) const
+    {
+        return words[index / 64].load() & (1ull << (index % 64));
+    }
+};
+
+// Helper function to print how long a gc/fsck phase took
+void report_phase(const std::string& description, std::chrono::steady_clock::time_point start)
+{
+    trace::region_ended("phase", start, description);
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    progress_output() << description << " in " << std::fixed << std::setprecision(1) << milliseconds << " ms" << std::endl;
+}
+
+// Deletes loose objects unreachable from HEAD, the branches and the index that are older than the grace period
+bool gc(std::time_t grace_seconds)
+{
+    // Enumerate: the sorted object listing doubles as the id -> bit position mapping
+    auto phase_start = std::chrono::steady_clock::now();
+    // Temporary files left behind by an interrupted batch write are removed once they are past the grace period
+    auto cutoff = fs::file_time_type::clock::now() - std::chrono::seconds(grace_seconds);
+    std::vector<std::string> object_ids;
+    size_t stale_temp_files = 0;
+    for (const auto& entry : fs::directory_iterator(repo_path(".minigit/objects")))
+    {
+        std::string name = entry.path().filename().string();
+        std::error_code ec;
+        if (is_object_id(name))
+        {
+            object_ids.push_back(name);
+        }
+        else if (name.rfind("tmp_obj_", 0) == 0 && entry.last_write_time(ec) <= cutoff && !ec)
+        {
+            stale_temp_files += fs::remove(entry.path(), ec);
+        }
+    }
+    std::sort(object_ids.begin(), object_ids.end());
+    if (stale_temp_files > 0)
+    {
+        progress_output() << "Removed " << stale_temp_files << " stale temporary object files" << std::endl;
+    }
+    ObjectMarks marks(std::move(object_ids));
+    report_phase("Enumerated " + std::to_string(marks.ids.size()) + " objects", phase_start);
+
+    // Mark: worker threads share a stack of commits whose blobs and parents still need visiting
+    phase_start = std::chrono::steady_clock::now();
+    std::vector<size_t> work;
+    std::mutex work_mutex;
+    std::condition_variable work_ready;
+    size_t busy_workers = 0;
+
+    auto mark_root = [&](const std::string& object_hash) {
+        size_t index = marks.find(object_hash);
+        if (index != marks.ids.size() && marks.mark(index))
+        {
+            work.push_back(index);
+        }
+    };
+    mark_root(resolve_head());
+    for (const auto& [branch_name, tip] : list_refs())
+    {
+        mark_root(tip);
+    }
+
+    // Chunks of a chunked file are reachable through its manifest
+    auto mark_chunks = [&](const std::string& blob_hash) {
+        ChunkManifest manifest;
+        if (read_chunk_manifest(blob_hash, manifest))
+        {
+            for (const auto& [chunk_hash, length] : manifest.chunks)
+            {
+                size_t index = marks.find(chunk_hash);
+                if (index != marks.ids.size())
+                {
+                    marks.mark(index);
+                }
+            }
+        }
+    };
+
+    // Staged blobs are not referenced by any commit yet but must survive
+    std::ifstream index_file(repo_path(".minigit/index"));
+    std::string line;
+    while (std::getline(index_file, line))
+    {
+        size_t index = marks.find(line.substr(0, line.find(' ')));
+        if (index != marks.ids.size() && marks.mark(index))
+        {
+            mark_chunks(marks.ids[index]);
+        }
+    }
+    index_file.close();
+
+    auto mark_worker = [&]() {
+        std::unique_lock<std::mutex> lock(work_mutex);
+        while (true)
+        {
+            work_ready.wait(lock, [&]() { return !work.empty() || busy_workers == 0; });
+            if (work.empty())
+            {
+                work_ready.notify_all();
+                return;
+            }
+            size_t commit_index = work.back();
+            work.pop_back();
+            busy_workers++;
+            lock.unlock();
+
+            const std::string& commit_hash = marks.ids[commit_index];
+            std::vector<size_t> new_commits;
+            for (const auto& [filename, file_sha1] : get_files_from_commit(commit_hash))
+            {
+                size_t index = marks.find(file_sha1);
+                if (index != marks.ids.size() && marks.mark(index))
+                {
+                    mark_chunks(file_sha1);
+                }
+            }
+            CommitInfo info;
+            read_commit(commit_hash, info);
+            for (const std::string& parent : info.parents)
+            {
+                size_t index = marks.find(parent);
+                if (index != marks.ids.size() && marks.mark(index))
+                {
+                    new_commits.push_back(index);
+                }
+            }
+
+            lock.lock();
+            work.insert(work.end(), new_commits.begin(), new_commits.end());
+            busy_workers--;
+            work_ready.notify_all();
+        }
+    };
+    run_workers(std::max(1u, std::thread::hardware_concurrency()), [&](size_t) { mark_worker(); });
+    size_t reachable = 0;
+    for (size_t i = 0; i < marks.ids.size(); i++)
+    {
+        reachable += marks.marked(i);
+    }
+    report_phase("Marked " + std::to_string(reachable) + " reachable objects", phase_start);
+
+    // Sweep: unreachable objects younger than the grace period may belong to an operation in progress
+    phase_start = std::chrono::steady_clock::now();
+    std::atomic<size_t> removed{0};
+    std::atomic<size_t> kept_recent{0};
+    std::atomic<uint64_t> reclaimed_bytes{0};
+    parallel_for(marks.ids.size(), [&](size_t i) {
+        if (marks.marked(i))
+        {
+            return;
+        }
+        std::error_code ec;
+        fs::path object_path = repo_path(".minigit/objects/" + marks.ids[i]);
+        if (fs::last_write_time(object_path, ec) > cutoff || ec)
+        {
+            kept_recent++;
+            return;
+        }
+        uint64_t size = fs::file_size(object_path, ec);
+        if (fs::remove(object_path, ec))
+        {
+            removed++;
+            reclaimed_bytes += size;
+        }
+    });
+    report_phase("Swept " + std::to_string(removed.load()) + " unreachable objects (" +
+                 std::to_string(reclaimed_bytes.load()) + " bytes reclaimed, " +
+                 std::to_string(kept_recent.load()) + " within grace period)", phase_start);
+
+    // The in-memory existence index and commit graph still list the removed objects
+    Repository::State& repository = current_repository();
+    repository.object_index.reset();
+
+    // Drop commit-graph lines for commits that no longer exist
+    if (removed > 0 && fs::exists(repo_path(".minigit/info/commit-graph")))
+    {
+        repository.commit_graph.reset();
+        std::ifstream graph_in(repo_path(".minigit/info/commit-graph"));
+        std::string kept_lines;
+        while (std::getline(graph_in, line))
+        {
+            std::string commit_hash;
+            CommitGraphEntry entry;
+            size_t index = parse_commit_graph_line(line, commit_hash, entry) ? marks.find(commit_hash) : marks.ids.size();
+            if (index != marks.ids.size() && (marks.marked(index) || fs::exists(repo_path(".minigit/objects/" + marks.ids[index]))))
+            {
+                kept_lines += line + "\n";
+            }
+        }
+        graph_in.close();
+        return write_file_atomic(repo_path(".minigit/info/commit-graph"), kept_lines);
+    }
+    return true;
+}
+
+// What fsck learned about one object while rehashing it
+struct FsckObject
+{
+    bool hash_ok = false;
+    bool commit_shaped = false; // Starts with the commit header; user files may too
+    bool is_commit = false;     // Reachable from a ref as a commit, or a well-formed dangling commit
+    std::string commit_error;
+    std::vector<std::string> parents;
+    std::vector<std::pair<std::string, std::string>> files; // (blob, path)
+    std::vector<std::string> chunks; // Set when the object is a chunk manifest
+};
+
+// Helper function to check the structure of a commit object's content
+void fsck_parse_commit(const std::string& content, FsckObject& result)
+{
+    std::istringstream commit_stream(content);
+    std::string line;
+    std::getline(commit_stream, line);
+    if (line.rfind("tree ", 0) != 0)
+    {
+        result.commit_error = "missing tree header";
+        return;
+    }
+    bool has_author = false, has_committer = false;
+    while (std::getline(commit_stream, line) && !line.empty())
+    {
+        if (line.rfind("parent ", 0) == 0)
+        {
+            if (!is_object_id(line.substr(7)))
+            {
+                result.commit_error = "malformed parent line \"" + line + "\"";
+                return;
+            }
+            result.parents.push_back(line.substr(7));
+        }
+        else if (line.rfind("author ", 0) == 0)
+        {
+            has_author = true;
+        }
+        else if (line.rfind("committer ", 0) == 0)
+        {
+            has_committer = true;
+        }
+        else
+        {
+            result.commit_error = "unexpected header \"" + line + "\"";
+            return;
+        }
+    }
+    if (!has_author || !has_committer)
+    {
+        result.commit_error = "missing author or committer";
+        return;
+    }
+    std::getline(commit_stream, line); // Commit message
+    while (std::getline(commit_stream, line))
+    {
+        size_t space = line.find(' ');
+        if (space == std::string::npos || !is_object_id(line.substr(0, space)))
+        {
+            result.commit_error = "malformed file entry \"" + line + "\"";
+            return;
+        }
+        result.files.push_back({line.substr(0, space), line.substr(space + 1)});
+    }
+}
+
+// Verifies that every object hashes to its name, that commits are well formed and that all references resolve.
+// Returns false when corruption or missing objects were found.
+bool fsck()
+{
+    auto phase_start = std::chrono::steady_clock::now();
+    std::vector<std::string> object_ids;
+    for (const auto& entry : fs::directory_iterator(repo_path(".minigit/objects")))
+    {
+        std::string name = entry.path().filename().string();
+        if (is_object_id(name))
+        {
+            object_ids.push_back(name);
+        }
+    }
+    std::sort(object_ids.begin(), object_ids.end());
+
+    // Objects are read in batches through the I/O engine and rehashed in parallel; each worker only writes its own slot
+    std::vector<FsckObject> results(object_ids.size());
+    std::atomic<uint64_t> bytes_checked{0};
+    std::vector<io::ReadRequest> reads;
+    for (size_t first = 0, last = 0; first < object_ids.size(); first = last)
+    {
+        last = io_batch_end(first, object_ids.size(), [&](size_t i) { return size_on_disk(object_path(object_ids[i])); });
+        reads.assign(last - first, io::ReadRequest());
+        for (size_t i = 0; i < reads.size(); i++)
+        {
+            reads[i].path = object_path(object_ids[first + i]);
+        }
+        io::read_files(reads);
+        trace::count(trace::kObjectsRead, reads.size());
+        parallel_for(reads.size(), [&, first](size_t batch_index) {
+            size_t i = first + batch_index;
+            if (!reads[batch_index].ok)
+            {
+                return;
+            }
+            const std::string& content = reads[batch_index].data;
+            bytes_checked += content.size();
+            results[i].hash_ok = calculate_hash(content) == object_ids[i];
+            if (content.rfind("tree \n", 0) == 0)
+            {
+                results[i].commit_shaped = true;
+                fsck_parse_commit(content, results[i]);
+            }
+            else if (content.rfind(CHUNK_MANIFEST_HEADER, 0) == 0)
+            {
+                ChunkManifest manifest;
+                read_chunk_manifest(object_ids[i], manifest);
+                for (const auto& [chunk_hash, length] : manifest.chunks)
+                {
+                    results[i].chunks.push_back(chunk_hash);
+                }
+            }
+        });
+    }
+    trace::region_ended("rehash_objects", phase_start);
+    double seconds = std::max(1e-9, std::chrono::duration<double>(std::chrono::steady_clock::now() - phase_start).count());
+    progress_output() << "Checked " << object_ids.size() << " objects (" << bytes_checked.load() << " bytes) in "
+                      << std::fixed << std::setprecision(1) << seconds * 1000 << " ms, "
+                      << bytes_checked.load() / (1024.0 * 1024.0) / seconds << " MB/s (" << io::engine_name() << " I/O)" << std::endl;
+
+    bool healthy = true;
+    auto find_object = [&](const std::string& object_hash) -> size_t {
+        auto it = std::lower_bound(object_ids.begin(), object_ids.end(), object_hash);
+        return it != object_ids.end() && *it == object_hash ? static_cast<size_t>(it - object_ids.begin()) : object_ids.size();
+    };
+
+    // A blob may start with "tree " too, so commits are the objects reachable from branch tips and HEAD through
+    // parent links; an unreachable object only counts as a (dangling) commit when its whole header is well formed
+    std::vector<std::pair<std::string, std::string>> refs = list_refs();
+    std::string head_hash = resolve_head();
+    std::vector<size_t> pending;
+    for (const auto& [branch_name, tip] : refs)
+    {
+        pending.push_back(find_object(tip));
+    }
+    if (!head_hash.empty())
+    {
+        pending.push_back(find_object(head_hash));
+    }
+    while (!pending.empty())
+    {
+        size_t index = pending.back();
+        pending.pop_back();
+        if (index == object_ids.size() || results[index].is_commit)
+        {
+            continue;
+        }
+        results[index].is_commit = true;
+        if (!results[index].commit_shaped)
+        {
+            results[index].commit_error = "not a commit object";
+            continue;
+        }
+        for (const std::string& parent : results[index].parents)
+        {
+            pending.push_back(find_object(parent));
+        }
+    }
+    std::vector<char> known_blob(object_ids.size());
+    for (const FsckObject& result : results)
+    {
+        if (!result.is_commit)
+        {
+            continue;
+        }
+        for (const auto& [blob_hash, path] : result.files)
+        {
+            size_t index = find_object(blob_hash);
+            if (index != object_ids.size())
+            {
+                known_blob[index] = 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < object_ids.size(); i++)
+    {
+        FsckObject& result = results[i];
+        if (!result.is_commit && !known_blob[i] && result.commit_shaped && result.commit_error.empty())
+        {
+            result.is_commit = true;
+        }
+        else if (!result.is_commit)
+        {
+            result.commit_error.clear();
+            result.parents.clear();
+            result.files.clear();
+        }
+    }
+
+    for (size_t i = 0; i < object_ids.size(); i++)
+    {
+        if (!results[i].hash_ok)
+        {
+            progress_output() << "error: object " << object_ids[i] << " is corrupt (content does not match its name)" << std::endl;
+            healthy = false;
+        }
+        if (!results[i].commit_error.empty())
+        {
+            progress_output() << "error: commit " << object_ids[i] << ": " << results[i].commit_error << std::endl;
+            healthy = false;
+        }
+    }
+
+    // Connectivity: every parent and blob a commit names must exist
+    std::vector<char> referenced(object_ids.size());
+    for (size_t i = 0; i < object_ids.size(); i++)
+    {
+        for (const std::string& parent : results[i].parents)
+        {
+            size_t index = find_object(parent);
+            if (index == object_ids.size())
+            {
+                progress_output() << "missing commit " << parent << " (parent of " << object_ids[i] << ")" << std::endl;
+                healthy = false;
+                continue;
+            }
+            referenced[index] = 1;
+        }
+        for (const std::string& chunk_hash : results[i].chunks)
+        {
+            size_t index = find_object(chunk_hash);
+            if (index == object_ids.size())
+            {
+                progress_output() << "missing chunk " << chunk_hash << " (of manifest " << object_ids[i] << ")" << std::endl;
+                healthy = false;
+                continue;
+            }
+            referenced[index] = 1;
+        }
+        for (const auto& [blob_hash, path] : results[i].files)
+        {
+            size_t index = find_object(blob_hash);
+            if (index == object_ids.size())
+            {
+                progress_output() << "missing blob " << blob_hash << " (" << object_ids[i].substr(0, 7) << ":" << path << ")" << std::endl;
+                healthy = false;
+                continue;
+            }
+            referenced[index] = 1;
+        }
+    }
+
+    // Branch tips, HEAD and staged blobs count as references too
+    auto check_root = [&](const std::string& object_hash, const std::string& name) {
+        size_t index = find_object(object_hash);
+        if (index == object_ids.size())
+        {
+            progress_output() << "error: " << name << " points to missing object " << object_hash << std::endl;
+            healthy = false;
+            return;
+        }
+        referenced[index] = 1;
+    };
+    for (const auto& [branch_name, tip] : refs)
+    {
+        check_root(tip, "refs/heads/" + branch_name);
+    }
+    if (!head_hash.empty())
+    {
+        check_root(head_hash, "HEAD");
+    }
+    std::ifstream index_file(repo_path(".minigit/index"));
+    std::string line;
+    while (std::getline(index_file, line))
+    {
+        if (!line.empty())
+        {
+            check_root(line.substr(0, line.find(' ')), "index entry " + line.substr(line.find(' ') + 1));
+        }
+    }
+
+    for (size_t i = 0; i < object_ids.size(); i++)
+    {
+        if (!referenced[i])
+        {
+            progress_output() << "dangling " << (results[i].is_commit ? "commit " : "blob ") << object_ids[i] << std::endl;
+        }
+    }
+    return healthy;
+}
+
+// Folds every loose branch ref into .minigit/packed-refs and removes the loose files
+bool pack_refs()
+{
+    std::vector<std::pair<std::string, std::string>> refs = list_refs();
+    std::string content = "# pack-refs sorted\n";
+    for (const auto& [branch_name, commit_hash] : refs)
+    {
+        content += commit_hash + " refs/heads/" + branch_name + "\n";
+    }
+    if (!write_file_atomic(repo_path(".minigit/packed-refs"), content))
+    {
+        return false;
+    }
+    load_packed_refs() = refs;
+
+    // A loose ref is only removed if it still holds the value that was packed. The check and the removal
+    // happen under the ref's lock file, the one write_file_atomic takes, so an update racing with them
+    // either lands first and keeps its loose ref or fails to lock; a ref that is locked now is left loose.
+    size_t removed = 0;
+    for (const auto& [branch_name, commit_hash] : refs)
+    {
+        std::string loose_path = repo_path(".minigit/refs/heads/" + branch_name);
+        std::string lock_path = loose_path + ".lock";
+        int lock_fd = ::open(lock_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (lock_fd < 0)
+        {
+            continue;
+        }
+        ::close(lock_fd);
+        std::ifstream ref_file(loose_path);
+        std::string loose_hash;
+        if (std::getline(ref_file, loose_hash) && loose_hash == commit_hash)
+        {
+            ref_file.close();
+            removed += fs::remove(loose_path);
+        }
+        ::unlink(lock_path.c_str());
+    }
+    progress_output() << "Packed " << refs.size() << " refs (" << removed << " loose ref files removed)" << std::endl;
+    return true;
+}
+
+// Blob read from an import stream that has not been hashed and stored yet
+struct ImportBlob
+{
+    std::string mark;
+    std::string data;
+};
+
+// Helper function to turn "refs/heads/<name>" or a bare name into a branch name
+std::string import_branch_name(const std::string& ref)
+{
+    if (ref.rfind("refs/heads/", 0) == 0)
+    {
+        return ref.substr(11);
+    }
+    return ref;
+}
+
+// Helper function to read the payload announced by a "data <byte-count>" line
+bool read_import_data(std::istream& in, const std::string& data_line, std::string& data)
+{
+    std::string size_text = data_line.substr(std::min<size_t>(5, data_line.size()));
+    if (data_line.rfind("data ", 0) != 0 || size_text.empty() || size_text.size() > 18 ||
+        size_text.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+    // Read in bounded steps so a bogus size fails at the end of the stream instead of allocating it up front
+    size_t size = std::stoull(size_text);
+    data.clear();
+    while (data.size() < size)
+    {
+        size_t offset = data.size();
+        data.resize(offset + std::min<size_t>(size - offset, 16u << 20));
+        in.read(&data[offset], static_cast<std::streamsize>(data.size() - offset));
+        if (static_cast<size_t>(in.gcount()) != data.size() - offset)
+        {
+            return false;
+        }
+    }
+    if (in.peek() == '\n')
+    {
+        in.get();
+    }
+    return true;
+}
+
+// Helper function to turn "<name> <email> <unix-time> [tz]" into the identity format commit objects use
+std::string import_identity(const std::string& identity)
+{
+    size_t email_end = identity.rfind('>');
+    if (email_end == std::string::npos)
+    {
+        return identity;
+    }
+    std::time_t timestamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::stringstream rest(identity.substr(email_end + 1));
+    long long seconds = 0;
+    if (rest >> seconds)
+    {
+        timestamp = static_cast<std::time_t>(seconds);
+    }
+    return identity.substr(0, email_end + 1) + " " + format_commit_time(timestamp);
+}
+
+// Imports history from a fast-import style stream without touching the working tree or index.
+//
+// The stream is a sequence of blank-line separated commands:
+//   blob / mark :<n> / data <byte-count> / <raw bytes>
+//   commit <branch> / mark :<n> / author <name> <email> <unix-time> / committer ... /
+//       data <byte-count> / <message> / from <:mark|sha> / merge <:mark|sha> /
+//       M <:mark|sha> <path> / D <path>
+//   reset <branch> / from <:mark|sha>
+// Each commit starts from the files of its first parent (or the branch tip) and applies its M/D lines.
+bool import_history(std::istream& in)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    std::unordered_map<std::string, std::string> marks;
+    std::map<std::string, std::string> branch_tips;
+    std::unordered_map<std::string, std::map<std::string, std::string>> tip_files;
+    std::vector<ImportBlob> pending_blobs;
+    std::vector<std::pair<std::string, CommitGraphEntry>> graph_entries;
+    size_t pending_bytes = 0;
+    size_t commit_count = 0;
+    size_t blob_count = 0;
+    uint64_t blob_bytes = 0;
+
+    // Hashes the queued blobs in parallel and stores each distinct one once
+    auto flush_blobs = [&]() {
+        trace::Region region("import_blobs", pending_blobs.size(), "blobs");
+        std::vector<std::string> blob_sha1s(pending_blobs.size());
+        parallel_for(pending_blobs.size(), [&](size_t i) {
+            blob_sha1s[i] = calculate_hash(pending_blobs[i].data);
+        });
+        std::unordered_map<std::string, size_t> unique_blobs;
+        for (size_t i = 0; i < pending_blobs.size(); i++)
+        {
+            unique_blobs.emplace(blob_sha1s[i], i);
+            if (!pending_blobs[i].mark.empty())
+            {
+                marks[pending_blobs[i].mark] = blob_sha1s[i];
+            }
+        }
+        std::vector<std::pair<std::string, const std::string*>> to_write;
+        for (const auto& [blob_sha1, index] : unique_blobs)
+        {
+            to_write.push_back({blob_sha1, &pending_blobs[index].data});
+        }
+        write_objects(to_write);
+        pending_blobs.clear();
+        pending_bytes = 0;
+    };
+
+    auto resolve = [&](const std::string& ref) -> std::string {
+        if (!ref.empty() && ref[0] == ':')
+        {
+            auto it = marks.find(ref);
+            return it == marks.end() ? "" : it->second;
+        }
+        return ref;
+    };
+
+    auto branch_tip = [&](const std::string& branch_name) -> std::string {
+        auto it = branch_tips.find(branch_name);
+        if (it != branch_tips.end())
+        {
+            return it->second;
+        }
+        return read_ref(branch_name);
+    };
+
+    std::string line;
+    size_t line_number = 0;
+    bool line_pushed_back = false; // The current line is handed out again by the next call
+    auto next_line = [&]() -> bool {
+        if (line_pushed_back)
+        {
+            line_pushed_back = false;
+            return true;
+        }
+        if (!std::getline(in, line))
+        {
+            return false;
+        }
+        line_number++;
+        return true;
+    };
+
+    while (next_line())
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line == "blob")
+        {
+            ImportBlob blob;
+            if (next_line() && line.rfind("mark ", 0) == 0)
+            {
+                blob.mark = line.substr(5);
+                next_line();
+            }
+            if (!read_import_data(in, line, blob.data))
+            {
+                error_output() << "Error: Expected blob data at line " << line_number << std::endl;
+                return false;
+            }
+            blob_count++;
+            blob_bytes += blob.data.size();
+            pending_bytes += blob.data.size();
+            pending_blobs.push_back(std::move(blob));
+            if (pending_bytes >= (64u << 20))
+            {
+                flush_blobs();
+            }
+        }
+        else if (line.rfind("commit ", 0) == 0)
+        {
+            flush_blobs();
+            std::string branch_name = import_branch_name(line.substr(7));
+            std::string mark, author, committer, message;
+            std::vector<std::string> parents;
+            std::vector<std::pair<char, std::string>> changes;
+
+            while (next_line() && !line.empty())
+            {
+                if (line.rfind("mark ", 0) == 0)
+                {
+                    mark = line.substr(5);
+                }
+                else if (line.rfind("author ", 0) == 0)
+                {
+                    author = import_identity(line.substr(7));
+                }
+                else if (line.rfind("committer ", 0) == 0)
+                {
+                    committer = import_identity(line.substr(10));
+                }
+                else if (line.rfind("data ", 0) == 0)
+                {
+                    if (!read_import_data(in, line, message))
+                    {
+                        error_output() << "Error: Malformed or truncated commit message at line " << line_number << std::endl;
+                        return false;
+                    }
+                }
+                else if (line.rfind("from ", 0) == 0 || line.rfind("merge ", 0) == 0)
+                {
+                    std::string parent = resolve(line.substr(line.find(' ') + 1));
+                    if (parent.empty())
+                    {
+                        error_output() << "Error: Unknown parent at line " << line_number << std::endl;
+                        return false;
+                    }
+                    parents.push_back(parent);
+                }
+                else if (line.rfind("M ", 0) == 0)
+                {
+                    changes.push_back({'M', line.substr(2)});
+                }
+                else if (line.rfind("D ", 0) == 0)
+                {
+                    changes.push_back({'D', line.substr(2)});
+                }
+                else
+                {
+                    error_output() << "Error: Unexpected line " << line_number << " in commit: " << line << std::endl;
+                    return false;
+                }
+            }
+
+            if (author.empty() && committer.empty())
+            {
+                error_output() << "Error: Commit ending at line " << line_number << " has no author" << std::endl;
+                return false;
+            }
+            if (author.empty())
+            {
+                author = committer;
+            }
+            if (committer.empty())
+            {
+                committer = author;
+            }
+            if (parents.empty())
+            {
+                std::string tip = branch_tip(branch_name);
+                if (!tip.empty())
+                {
+                    parents.push_back(tip);
+                }
+            }
+
+            std::map<std::string, std::string> parent_files;
+            if (!parents.empty())
+            {
+                auto it = tip_files.find(parents[0]);
+                trace::count(it != tip_files.end() ? trace::kCacheHits : trace::kCacheMisses);
+                parent_files = it != tip_files.end() ? it->second : get_files_from_commit(parents[0]);
+            }
+            std::map<std::string, std::string> files = parent_files;
+            for (const auto& [kind, change] : changes)
+            {
+                if (kind == 'D')
+                {
+                    files.erase(change);
+                    continue;
+                }
+                size_t space = change.find(' ');
+                std::string blob_sha1 = resolve(change.substr(0, space));
+                if (space == std::string::npos || !is_object_id(blob_sha1))
+                {
+                    error_output() << "Error: Bad file change \"M " << change << "\"" << std::endl;
+                    return false;
+                }
+                files[change.substr(space + 1)] = blob_sha1;
+            }
+
+            // Commit messages occupy a single line in the object format
+            while (!message.empty() && message.back() == '\n')
+            {
+                message.pop_back();
+            }
+            std::replace(message.begin(), message.end(), '\n', ' ');
+
+            std::string commit_content = "tree "; // Placeholder for tree hash
+            for (const std::string& parent : parents)
+            {
+                commit_content += "\nparent " + parent;
+            }
+            commit_content += "\nauthor " + author;
+            commit_content += "\ncommitter " + committer;
+            commit_content += "\n\n" + message + "\n";
+            for (const auto& [filename, file_sha1] : files)
+            {
+                commit_content += file_sha1 + " " + filename + "\n";
+            }
+
+            std::string commit_sha1 = calculate_hash(commit_content);
+            write_object(commit_sha1, commit_content);
+            if (!mark.empty())
+            {
+                marks[mark] = commit_sha1;
+            }
+            CommitInfo info;
+            info.parents = parents;
+            info.timestamp = parse_commit_time(committer);
+            graph_entries.push_back({commit_sha1, build_commit_graph_entry(info, files, parent_files)});
+
+            // Only branch tips keep their file lists in memory; older commits are re-read on demand
+            auto old_tip = branch_tips.find(branch_name);
+            if (old_tip != branch_tips.end())
+            {
+                bool still_a_tip = false;
+                for (const auto& [other_branch, other_tip] : branch_tips)
+                {
+                    still_a_tip |= other_branch != branch_name && other_tip == old_tip->second;
+                }
+                if (!still_a_tip)
+                {
+                    tip_files.erase(old_tip->second);
+                }
+            }
+            branch_tips[branch_name] = commit_sha1;
+            tip_files[commit_sha1] = std::move(files);
+            commit_count++;
+        }
+        else if (line.rfind("reset ", 0) == 0)
+        {
+            flush_blobs();
+            std::string branch_name = import_branch_name(line.substr(6));
+            if (next_line())
+            {
+                if (line.rfind("from ", 0) == 0)
+                {
+                    std::string tip = resolve(line.substr(5));
+                    if (tip.empty())
+                    {
+                        error_output() << "Error: Unknown commit at line " << line_number << std::endl;
+                        return false;
+                    }
+                    branch_tips[branch_name] = tip;
+                }
+                else
+                {
+                    // Without a "from" the line already starts the next command
+                    line_pushed_back = true;
+                }
+            }
+        }
+        else
+        {
+            error_output() << "Error: Unknown import command at line " << line_number << ": " << line << std::endl;
+            return false;
+        }
+    }
+    flush_blobs();
+    if (!append_commit_graph(graph_entries))
+    {
+        return false;
+    }
+
+    for (const auto& [branch_name, tip] : branch_tips)
+    {
+        if (!write_ref(branch_name, tip))
+        {
+            return false;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    double megabytes = blob_bytes / (1024.0 * 1024.0);
+    seconds = std::max(seconds, 1e-9);
+    progress_output() << "Imported " << commit_count << " commits and " << blob_count << " blobs ("
+                      << std::fixed << std::setprecision(2) << megabytes << " MB) in " << seconds << "s" << std::endl;
+    progress_output() << "Throughput: " << commit_count / seconds << " commits/s, " << megabytes / seconds << " MB/s" << std::endl;
+    return true;
+}
+
+// Binds a Repository operation to the calling thread and holds the handle's lock while it runs: shared
+// for reads, exclusive for writes. Caches whose files were changed by someone else are dropped first.
+// A write operation makes its objects durable and takes fresh stamps of its caches before unlocking.
+class Call
+{
+public:
+    Call(Repository::State& state, bool exclusive) : state_(state), exclusive_(exclusive), previous_(current_call)
+    {
+        context_.repository = &state;
+        current_call = &context_;
+        if (exclusive_)
+        {
+            state_.mutex.lock();
+            state_.refresh();
+            state_.pending.failed = false;
+        }
+        else
+        {
+            state_.mutex.lock_shared();
+            if (state_.stale())
+            {
+                state_.mutex.unlock_shared();
+                state_.mutex.lock();
+                state_.refresh();
+                state_.mutex.unlock();
+                state_.mutex.lock_shared();
+            }
+        }
+        // core.io applies to this handle's batches only, so handles in one process can differ
+        context_.io_engine = read_config("core.io", "auto");
+        engine_.emplace(context_.io_engine);
+    }
+
+    ~Call()
+    {
+        if (exclusive_)
+        {
+            // Normally a no-op: run() already flushed, unless the operation threw
+            try
+            {
+                flush_object_writes();
+            }
+            catch (const std::exception&)
+            {
+            }
+            state_.restamp();
+            state_.mutex.unlock();
+        }
+        else
+        {
+            state_.mutex.unlock_shared();
+        }
+        current_call = previous_;
+    }
+
+    Call(const Call&) = delete;
+    Call& operator=(const Call&) = delete;
+
+    // Hands the messages reported during the operation to its result
+    template <typename ResultType>
+    ResultType finish(ResultType result)
+    {
+        result.error += context_.errors.str();
+        return result;
+    }
+
+    Result finish(bool ok)
+    {
+        Result result;
+        result.ok = ok;
+        return finish(result);
+    }
+
+    // Runs an operation returning a result (or a bool) and finishes it. An exception escaping the operation,
+    // such as one thrown while parsing a damaged file, fails the result instead of reaching the caller.
+    // Objects an exclusive operation wrote are flushed before the result is finished, so a failure to store
+    // one reaches the caller too.
+    template <typename ResultType, typename Operation>
+    ResultType run(Operation operation)
+    {
+        ResultType result;
+        try
+        {
+            if constexpr (std::is_same_v<decltype(operation()), bool>)
+            {
+                result.ok = operation();
+            }
+            else
+            {
+                result = operation();
+            }
+            if (exclusive_ && !flush_object_writes())
+            {
+                result.ok = false;
+            }
+        }
+        catch (const std::exception& exception)
+        {
+            result = ResultType();
+            result.ok = false;
+            error_output() << "Error: " << exception.what() << std::endl;
+        }
+        return finish(result);
+    }
+
+    // The same for reads that return a plain value, which answer fallback when the operation throws
+    template <typename Value, typename Operation>
+    Value read(Operation operation, Value fallback = Value())
+    {
+        try
+        {
+            return operation();
+        }
+        catch (const std::exception&)
+        {
+            return fallback;
+        }
+    }
+
+private:
+    Repository::State& state_;
+    bool exclusive_;
+    CallContext context_;
+    CallContext* previous_;
+    std::optional<io::ScopedEngine> engine_;
+};
+
+// Helper function to set up the state of a handle on the repository under root
+std::unique_ptr<Repository::State> make_state(const std::string& root, const Repository::Options& options)
+{
+    std::unique_ptr<Repository::State> state = std::make_unique<Repository::State>();
+    if (!root.empty() && root != ".")
+    {
+        state->root_prefix = root.back() == '/' ? root : root + "/";
+    }
+    state->options = options;
+    state->commits.capacity = options.commit_cache_size;
+    state->file_lists.capacity = options.file_list_cache_size;
+    return state;
+}
+
+InitResult Repository::init(const std::string& root, const std::string& hash_name)
+{
+    InitResult result;
+    const hashing::Algorithm* algorithm = hashing::find_algorithm(hash_name.empty() ? "sha1" : hash_name);
+    if (algorithm == nullptr)
+    {
+        result.ok = false;
+        result.error = "Error: Unknown hash algorithm '" + hash_name + "' (expected " + hashing::algorithm_names() + ")\n";
+        return result;
+    }
+    std::unique_ptr<State> state = make_state(root, Options());
+    state->hash = algorithm;
+    Call call(*state, true);
+    result.git_dir = (fs::absolute(repo_path(".")) / ".minigit").lexically_normal().string();
+    return call.run<InitResult>([&]() {
+        result.ok = minigit::init(hash_name, result.created);
+        return result;
+    });
+}
+
+std::unique_ptr<Repository> Repository::open(const std::string& root, const Options& options, std::string& error)
+{
+    std::unique_ptr<State> state = make_state(root, options);
+    if (!fs::is_directory(state->root_prefix + ".minigit"))
+    {
+        error = "Error: Not a MiniGit repository (no .minigit directory in " + (root.empty() ? "." : root) + ")\n";
+        return nullptr;
+    }
+    std::string hash_name;
+    {
+        Call call(*state, false);
+        hash_name = read_config("core.hash", "sha1");
+    }
+    state->hash = hashing::find_algorithm(hash_name);
+    if (state->hash == nullptr)
+    {
+        error = "Error: Unknown hash algorithm '" + hash_name + "' in .minigit/config\n";
+        return nullptr;
+    }
+    return std::unique_ptr<Repository>(new Repository(std::move(state)));
+}
+
+Repository::Repository(std::unique_ptr<State> state) : state_(std::move(state)) {}
+
+Repository::~Repository() = default;
+
+std::string Repository::head() const
+{
+    Call call(*state_, false);
+    return call.read<std::string>([]() { return resolve_head(); });
+}
+
+std::string Repository::current_branch() const
+{
+    Call call(*state_, false);
+    return call.read<std::string>([]() { return minigit::current_branch(); });
+}
+
+std::string Repository::resolve(const std::string& name) const
+{
+    Call call(*state_, false);
+    return call.read<std::string>([&]() {
+        std::string commit_hash = read_ref(name);
+        if (commit_hash.empty() && object_exists(name))
+        {
+            commit_hash = name;
+        }
+        return commit_hash;
+    });
+}
+
+std::vector<BranchInfo> Repository::branches() const
+{
+    Call call(*state_, false);
+    return call.read<std::vector<BranchInfo>>([]() { return list_branches(); });
+}
+
+bool Repository::read_commit(const std::string& id, CommitInfo& info) const
+{
+    Call call(*state_, false);
+    info = CommitInfo();
+    return call.read<bool>([&]() { return minigit::read_commit(id, info); });
+}
+
+FileList Repository::files(const std::string& commit) const
+{
+    Call call(*state_, false);
+    return call.read<FileList>([&]() { return get_files_from_commit(commit); });
+}
+
+bool Repository::read_blob(const std::string& id, std::string& content) const
+{
+    Call call(*state_, false);
+    return call.read<bool>([&]() {
+        ChunkManifest manifest;
+        if (!read_chunk_manifest(id, manifest))
+        {
+            return read_object(id, content);
+        }
+        content.clear();
+        content.reserve(manifest.total_size);
+        std::string chunk;
+        for (const auto& [chunk_hash, length] : manifest.chunks)
+        {
+            if (!read_object(chunk_hash, chunk))
+            {
+                return false;
+            }
+            content += chunk;
+        }
+        return true;
+    });
+}
+
+std::string Repository::merge_base(const std::string& commit1, const std::string& commit2) const
+{
+    Call call(*state_, false);
+    return call.read<std::string>([&]() { return find_common_ancestor(commit1, commit2); });
+}
+
+LogResult Repository::log(const LogOptions& options) const
+{
+    Call call(*state_, false);
+    return call.run<LogResult>([&]() {
+        LogResult result;
+        result.commits = minigit::log(options);
+        return result;
+    });
+}
+
+StatusResult Repository::status() const
+{
+    Call call(*state_, false);
+    return call.run<StatusResult>([]() { return minigit::status(); });
+}
+
+std::string Repository::config(const std::string& key, const std::string& default_value) const
+{
+    Call call(*state_, false);
+    return call.read<std::string>([&]() { return read_config(key, default_value); }, default_value);
+}
+
+std::string Repository::hash_algorithm() const
+{
+    return state_->hash->name;
+}
+
+std::string Repository::sparse_checkout_patterns() const
+{
+    Call call(*state_, false);
+    return call.read<std::string>([]() { return read_file_content(repo_path(".minigit/info/sparse-checkout")); });
+}
+
+AddResult Repository::add(const std::vector<std::string>& paths)
+{
+    Call call(*state_, true);
+    return call.run<AddResult>([&]() {
+        AddResult result;
+        result.files = minigit::add(paths);
+        result.ok = std::all_of(result.files.begin(), result.files.end(), [](const AddedFile& file) { return !file.id.empty(); });
+        return result;
+    });
+}
+
+CommitResult Repository::commit(const std::string& message)
+{
+    Call call(*state_, true);
+    return call.run<CommitResult>([&]() { return minigit::commit(message); });
+}
+
+Result Repository::create_branch(const std::string& name)
+{
+    Call call(*state_, true);
+    return call.run<Result>([&]() { return branch(name); });
+}
+
+Result Repository::checkout(const std::string& target, bool verify)
+{
+    Call call(*state_, true);
+    return call.run<Result>([&]() { return minigit::checkout(target, verify); });
+}
+
+MergeResult Repository::merge(const std::string& branch)
+{
+    Call call(*state_, true);
+    return call.run<MergeResult>([&]() { return minigit::merge(branch); });
+}
+
+Result Repository::set_config(const std::string& key, const std::string& value)
+{
+    Call call(*state_, true);
+    return call.run<Result>([&]() {
+        if (key == "core.hash")
+        {
+            // Every stored object is named by this hash, so it can only be chosen at init
+            error_output() << "Error: core.hash cannot be changed after init" << std::endl;
+            return false;
+        }
+        if (key == "chunk.threshold" && !valid_chunk_threshold(value))
+        {
+            error_output() << "Error: chunk.threshold must be a size in bytes (0 disables chunking)" << std::endl;
+            return false;
+        }
+        return write_config(key, value);
+    });
+}
+
+Result Repository::sparse_checkout(const std::string& subcommand, const std::vector<std::string>& patterns)
+{
+    Call call(*state_, true);
+    return call.run<Result>([&]() { return minigit::sparse_checkout(subcommand, patterns); });
+}
+
+Result Repository::write_commit_graph()
+{
+    Call call(*state_, true);
+    return call.run<Result>([]() { return minigit::write_commit_graph(); });
+}
+
+Result Repository::gc(std::time_t grace_seconds)
+{
+    Call call(*state_, true);
+    return call.run<Result>([&]() { return minigit::gc(grace_seconds); });
+}
+
+Result Repository::fsck()
+{
+    Call call(*state_, false);
+    return call.run<Result>([]() { return minigit::fsck(); });
+}
+
+Result Repository::pack_refs()
+{
+    Call call(*state_, true);
+    return call.run<Result>([]() { return minigit::pack_refs(); });
+}
+
+Result Repository::import(std::istream& stream)
+{
+    Call call(*state_, true);
+    return call.run<Result>([&]() { return import_history(stream); });
+}
 
+} // namespace minigit
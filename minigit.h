@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// libminigit: the MiniGit core as a linkable C++ library.
+//
+// A Repository is a handle on one repository directory. Its operations return typed results instead
+// of printing, and the handle keeps its caches (settings, packed refs, the commit graph, the object
+// existence index, sparse checkout patterns and recently parsed commits) from one call to the next,
+// reloading a cache only when its file changes on disk. One handle may be shared between threads:
+// read operations run concurrently, while operations that change the repository or its working tree
+// run one at a time. Batched file I/O follows each handle's own core.io setting. The minigit
+// command-line tool (minigit_cli.cpp) is a thin wrapper over this API.
+namespace minigit
+{
+
+// Outcome shared by every operation: ok is false when the operation failed, and error holds the
+// messages explaining why (one per line). Warnings about an operation that still succeeded also end
+// up in error while ok stays true. A working-tree file that could not be restored from its object is
+// never written, and makes the operation fail. Operations do not throw: an exception inside one
+// fails its result instead.
+struct Result
+{
+    bool ok = true;
+    std::string error;
+};
+
+// Header fields and message of a commit
+struct CommitInfo
+{
+    std::string id;
+    std::vector<std::string> parents;
+    std::string author;        // Full "author ..." line
+    std::string committer;     // Full "committer ..." line
+    std::string message;
+    std::time_t timestamp = 0; // Committer time
+};
+
+// The files recorded by a commit: path -> blob id, sorted by path
+using FileList = std::map<std::string, std::string>;
+
+// Options accepted by Repository::log
+struct LogOptions
+{
+    size_t max_count = 0;             // 0 means no limit
+    std::time_t since = 0;            // 0 means no lower bound
+    std::time_t until = 0;            // 0 means no upper bound
+    bool first_parent = false;
+    std::vector<std::string> paths;   // Only report commits that change one of these files or directories ("src", "src/", "./src")
+};
+
+struct LogResult : Result
+{
+    std::vector<CommitInfo> commits;  // Newest first
+};
+
+// One path handed to Repository::add
+struct AddedFile
+{
+    std::string path;
+    std::string id;     // Blob id; empty when the file could not be stored
+    std::string error;  // Why it could not
+};
+
+struct AddResult : Result
+{
+    std::vector<AddedFile> files;  // In the order the paths were given
+};
+
+struct CommitResult : Result
+{
+    std::string id;
+    std::string branch;  // The branch that now points at the commit
+};
+
+struct BranchInfo
+{
+    std::string name;
+    std::string tip;
+    bool current = false;  // HEAD points at this branch
+};
+
+struct MergeResult : Result
+{
+    bool up_to_date = false;             // Both branches were at the same commit; nothing changed
+    std::string commit;                  // The merge commit, when one was made
+    std::string branch;                  // The branch that was merged into
+    FileList updated;                    // Files taken from the merged branch and staged
+    std::vector<std::string> conflicts;  // Files changed differently on both sides; no commit is made
+};
+
+// One staged file reported by Repository::status
+struct StagedFile
+{
+    std::string path;
+    std::string id;
+    bool in_sparse_checkout = true;
+};
+
+struct StatusResult : Result
+{
+    std::string branch;            // Empty when HEAD is detached
+    std::string head;              // Commit HEAD points at; empty before the first commit
+    bool sparse_checkout = false;
+    size_t sparse_patterns = 0;
+    std::vector<StagedFile> staged;
+};
+
+struct InitResult : Result
+{
+    bool created = false;  // False when the repository already existed
+    std::string git_dir;   // Absolute path of the .minigit directory
+};
+
+// One line of a diff: ' ' for a line both files share, '-' for a removed line, '+' for an added one
+struct DiffLine
+{
+    char kind = ' ';
+    std::string text;
+};
+
+// A run of changed lines and their context; line numbers are 1-based
+struct DiffHunk
+{
+    size_t old_start = 0;
+    size_t old_count = 0;
+    size_t new_start = 0;
+    size_t new_count = 0;
+    std::vector<DiffLine> lines;
+};
+
+struct DiffResult : Result
+{
+    std::vector<DiffHunk> hunks;
+};
+
+// Context size that puts every line of both files into a single hunk
+constexpr size_t WHOLE_FILE = static_cast<size_t>(-1);
+
+// Compares two files line by line, keeping `context` unchanged lines around each change.
+// Needs no repository.
+DiffResult diff_files(const std::string& file1_path, const std::string& file2_path, size_t context = 3);
+
+class Repository
+{
+public:
+    struct Options
+    {
+        std::ostream* progress = nullptr;  // Reports and timings of maintenance operations; nullptr discards them
+        size_t commit_cache_size = 4096;   // Parsed commits kept in memory
+        size_t file_list_cache_size = 8;   // Commit file lists kept in memory
+    };
+
+    // Creates the repository under root ("." for the current directory) with objects named by the given
+    // hash algorithm (sha1 when empty). Initializing an existing repository again is harmless, but its
+    // hash algorithm cannot be changed.
+    static InitResult init(const std::string& root, const std::string& hash_name = "");
+
+    // Opens the repository under root; returns nullptr and sets error when there is none
+    static std::unique_ptr<Repository> open(const std::string& root, const Options& options, std::string& error);
+
+    ~Repository();
+    Repository(const Repository&) = delete;
+    Repository& operator=(const Repository&) = delete;
+
+    // Read operations; any number of threads may run these at once. Those returning a plain value
+    // answer an empty one (or false) when the repository cannot be read.
+    std::string head() const;                            // Commit HEAD resolves to; empty before the first commit
+    std::string current_branch() const;                  // Empty when HEAD is detached
+    std::string resolve(const std::string& name) const;  // Branch name or commit id -> commit id; empty if unknown
+    std::vector<BranchInfo> branches() const;
+    bool read_commit(const std::string& id, CommitInfo& info) const;
+    FileList files(const std::string& commit) const;
+    bool read_blob(const std::string& id, std::string& content) const;  // Chunked files are reassembled
+    std::string merge_base(const std::string& commit1, const std::string& commit2) const;
+    LogResult log(const LogOptions& options = LogOptions()) const;
+    StatusResult status() const;
+    std::string config(const std::string& key, const std::string& default_value = "") const;
+    std::string hash_algorithm() const;
+    std::string sparse_checkout_patterns() const;
+
+    // Operations that change the repository or its working tree; these run one at a time
+    AddResult add(const std::vector<std::string>& paths);  // Paths are relative to the repository root
+    CommitResult commit(const std::string& message);
+    Result create_branch(const std::string& name);
+    Result checkout(const std::string& target, bool verify = false);
+    MergeResult merge(const std::string& branch);
+    Result set_config(const std::string& key, const std::string& value);
+    Result sparse_checkout(const std::string& subcommand, const std::vector<std::string>& patterns);  // set, add or disable
+
+    // Maintenance; these write their reports and timings to Options::progress
+    Result write_commit_graph();
+    Result gc(std::time_t grace_seconds);
+    Result fsck();  // ok is false when corruption or missing objects were found
+    Result pack_refs();
+    Result import(std::istream& stream);
+
+    struct State;
+
+private:
+    explicit Repository(std::unique_ptr<State> state);
+
+    std::unique_ptr<State> state_;
+};
+
+} // namespace minigit
@@ -0,0 +1,401 @@
+// The minigit command-line tool: parses the arguments, calls libminigit and prints the results.
+// Everything it can do is also available in-process through minigit.h.
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include "minigit.h"
+#include "digest.h"
+#include "trace.h"
+
+namespace fs = std::filesystem;
+
+// Helper function to print an operation's messages and turn its outcome into the exit status
+int report(const minigit::Result& result)
+{
+    std::cerr << result.error;
+    return result.ok ? 0 : 1;
+}
+
+// Helper function to parse a non-negative decimal argument; false when it is not one
+bool parse_count(const std::string& argument, uint64_t& value)
+{
+    if (argument.empty() || argument.size() > 18 || argument.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+    value = std::stoull(argument);
+    return true;
+}
+
+// Helper function to parse a --since/--until argument given as YYYY-MM-DD[ HH:MM:SS] or @<unix-time>
+std::time_t parse_date_argument(const std::string& argument)
+{
+    if (!argument.empty() && argument[0] == '@')
+    {
+        uint64_t seconds = 0;
+        return parse_count(argument.substr(1), seconds) ? static_cast<std::time_t>(seconds) : 0;
+    }
+    std::tm time_fields = {};
+    std::istringstream time_stream(argument);
+    time_stream >> std::get_time(&time_fields, "%Y-%m-%d");
+    if (time_stream.fail())
+    {
+        return 0;
+    }
+    time_stream >> std::get_time(&time_fields, " %H:%M:%S");
+    time_fields.tm_isdst = -1;
+    return std::mktime(&time_fields);
+}
+
+// Helper function to print the commit history, in blocks rather than a flush per line
+void print_log(const minigit::LogResult& result, bool oneline)
+{
+    std::string out;
+    out.reserve(1 << 16);
+    for (const minigit::CommitInfo& info : result.commits)
+    {
+        if (oneline)
+        {
+            out += info.id.substr(0, 7) + " " + info.message + "\n";
+        }
+        else
+        {
+            out += "commit " + info.id + "\n";
+            out += info.author + "\n";
+            out += info.committer + "\n";
+            out += "\n    " + info.message + "\n\n";
+        }
+        if (out.size() >= (1 << 16))
+        {
+            std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
+}
+
+// Helper function to print the current branch and the staged files
+void print_status(const minigit::StatusResult& status)
+{
+    if (!status.branch.empty())
+    {
+        std::cout << "On branch " << status.branch << std::endl;
+    }
+    else
+    {
+        std::cout << "HEAD detached at " << status.head.substr(0, 7) << std::endl;
+    }
+    if (status.sparse_checkout)
+    {
+        std::cout << "You are in a sparse checkout (" << status.sparse_patterns << " patterns)." << std::endl;
+    }
+
+    if (status.staged.empty())
+    {
+        std::cout << "\nnothing to commit, working tree clean" << std::endl;
+        return;
+    }
+    std::cout << "\nChanges to be committed:" << std::endl;
+    for (const minigit::StagedFile& file : status.staged)
+    {
+        std::cout << "  new file:   " << file.path << (file.in_sparse_checkout ? "" : " (outside sparse checkout)") << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: minigit <command> [args]\n";
+        return 1;
+    }
+
+    std::string command = argv[1];
+    trace::init_from_environment();
+    trace::Region command_region(argv[1]);
+
+    if (command == "init")
+    {
+        // The object-id hash is chosen once, here: --hash=sha1 (the default), sha256 or blake3
+        std::string hash_name;
+        if (argc >= 3 && std::string(argv[2]).rfind("--hash=", 0) == 0 &&
+            hashing::find_algorithm(std::string(argv[2]).substr(7)) != nullptr)
+        {
+            hash_name = std::string(argv[2]).substr(7);
+        }
+        else if (argc >= 3)
+        {
+            std::cerr << "Usage: minigit init [--hash=" << hashing::algorithm_names() << "]\n";
+            return 1;
+        }
+        minigit::InitResult result = minigit::Repository::init(".", hash_name);
+        if (result.ok)
+        {
+            std::cout << (result.created ? "Initialized empty MiniGit repository in " : "MiniGit repository already initialized in ")
+                      << fs::path(result.git_dir) << std::endl;
+        }
+        return report(result);
+    }
+    if (command == "diff")
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Usage: minigit diff <file1> <file2>\n";
+            return 1;
+        }
+        minigit::DiffResult result = minigit::diff_files(argv[2], argv[3], minigit::WHOLE_FILE);
+        std::string out;
+        for (const minigit::DiffHunk& hunk : result.hunks)
+        {
+            for (const minigit::DiffLine& line : hunk.lines)
+            {
+                out += (line.kind == ' ' ? "  " : std::string(1, line.kind) + " ") + line.text + "\n";
+            }
+        }
+        std::cout << out;
+        return report(result);
+    }
+
+    // Maintenance commands report their progress and timings on stdout
+    minigit::Repository::Options options;
+    options.progress = &std::cout;
+    std::string error;
+    std::unique_ptr<minigit::Repository> repository = minigit::Repository::open(".", options, error);
+    if (!repository)
+    {
+        std::cerr << error;
+        return 1;
+    }
+
+    if (command == "add")
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage: minigit add <filename>...\n";
+            return 1;
+        }
+        minigit::AddResult result = repository->add(std::vector<std::string>(argv + 2, argv + argc));
+        for (const minigit::AddedFile& file : result.files)
+        {
+            if (!file.id.empty())
+            {
+                std::cout << "Added " << file.path << " (" << file.id << ")" << std::endl;
+            }
+        }
+        return report(result);
+    }
+    else if (command == "commit")
+    {
+        if (argc < 4 || std::string(argv[2]) != "-m")
+        {
+            std::cerr << "Usage: minigit commit -m \"<message>\"\n";
+            return 1;
+        }
+        std::string message = argv[3];
+        minigit::CommitResult result = repository->commit(message);
+        if (result.ok)
+        {
+            std::cout << "[" << result.branch << " (root-commit) " << result.id.substr(0, 7) << "] " << message << std::endl;
+        }
+        return report(result);
+    }
+    else if (command == "log")
+    {
+        minigit::LogOptions log_options;
+        bool oneline = false;
+        uint64_t count = 0;
+        for (int i = 2; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--")
+            {
+                log_options.paths.assign(argv + i + 1, argv + argc);
+                break;
+            }
+            else if (arg.rfind("-n", 0) == 0 && (arg.size() > 2 || i + 1 < argc) &&
+                     parse_count(arg.size() > 2 ? arg.substr(2) : argv[++i], count))
+            {
+                log_options.max_count = static_cast<size_t>(count);
+            }
+            else if (arg.rfind("--since=", 0) == 0 || arg.rfind("--until=", 0) == 0)
+            {
+                std::time_t bound = parse_date_argument(arg.substr(8));
+                if (bound == 0)
+                {
+                    std::cerr << "Error: Could not parse date \"" << arg.substr(8) << "\"" << std::endl;
+                    return 1;
+                }
+                (arg[2] == 's' ? log_options.since : log_options.until) = bound;
+            }
+            else if (arg == "--oneline")
+            {
+                oneline = true;
+            }
+            else if (arg == "--first-parent")
+            {
+                log_options.first_parent = true;
+            }
+            else
+            {
+                std::cerr << "Usage: minigit log [-n <count>] [--since=<date>] [--until=<date>] [--oneline] [--first-parent] [-- <path>...]\n";
+                return 1;
+            }
+        }
+        minigit::LogResult result = repository->log(log_options);
+        print_log(result, oneline);
+        return report(result);
+    }
+    else if (command == "branch")
+    {
+        if (argc < 3)
+        {
+            // No arguments provided - list branches
+            std::vector<minigit::BranchInfo> branches = repository->branches();
+            if (branches.empty())
+            {
+                std::cout << "No branches found." << std::endl;
+            }
+            std::string out;
+            for (const minigit::BranchInfo& branch : branches)
+            {
+                out += (branch.current ? "* " : "  ") + branch.name + "\n";
+            }
+            std::cout << out;
+            return 0;
+        }
+        // Branch name provided - create new branch
+        minigit::Result result = repository->create_branch(argv[2]);
+        if (result.ok)
+        {
+            std::cout << "Branch \"" << argv[2] << "\" created at " << repository->resolve(argv[2]).substr(0, 7) << std::endl;
+        }
+        return report(result);
+    }
+    else if (command == "checkout")
+    {
+        bool verify = argc >= 3 && std::string(argv[2]) == "--verify";
+        if (argc < 3 + verify)
+        {
+            std::cerr << "Usage: minigit checkout [--verify] <branch-name> or <commit-hash>\n";
+            return 1;
+        }
+        minigit::Result result = repository->checkout(argv[2 + verify], verify);
+        if (result.ok)
+        {
+            std::cout << "Switched to " << argv[2 + verify] << std::endl;
+        }
+        return report(result);
+    }
+    else if (command == "merge")
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage: minigit merge <branch-name>\n";
+            return 1;
+        }
+        minigit::MergeResult result = repository->merge(argv[2]);
+        if (result.up_to_date)
+        {
+            std::cout << "Already up to date." << std::endl;
+        }
+        for (const auto& [filename, file_sha1] : result.updated)
+        {
+            std::cout << "Added " << filename << " (" << file_sha1 << ")" << std::endl;
+        }
+        if (!result.commit.empty())
+        {
+            std::cout << "Merged branch \"" << argv[2] << "\" into " << result.branch << std::endl;
+            std::cout << "Merge commit: " << result.commit.substr(0, 7) << std::endl;
+        }
+        return report(result);
+    }
+    else if (command == "status")
+    {
+        minigit::StatusResult result = repository->status();
+        print_status(result);
+        return report(result);
+    }
+    else if (command == "commit-graph")
+    {
+        return report(repository->write_commit_graph());
+    }
+    else if (command == "gc")
+    {
+        // Unreachable objects younger than two weeks are kept unless --grace=<seconds> says otherwise
+        std::time_t grace_seconds = 14 * 24 * 60 * 60;
+        uint64_t grace = 0;
+        if (argc >= 3 && std::string(argv[2]).rfind("--grace=", 0) == 0 && parse_count(std::string(argv[2]).substr(8), grace))
+        {
+            grace_seconds = static_cast<std::time_t>(grace);
+        }
+        else if (argc >= 3)
+        {
+            std::cerr << "Usage: minigit gc [--grace=<seconds>]\n";
+            return 1;
+        }
+        return report(repository->gc(grace_seconds));
+    }
+    else if (command == "fsck")
+    {
+        return report(repository->fsck());
+    }
+    else if (command == "pack-refs")
+    {
+        return report(repository->pack_refs());
+    }
+    else if (command == "config")
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage: minigit config <key> [<value>]\n";
+            return 1;
+        }
+        if (argc < 4)
+        {
+            std::cout << repository->config(argv[2]) << std::endl;
+            return 0;
+        }
+        return report(repository->set_config(argv[2], argv[3]));
+    }
+    else if (command == "sparse-checkout")
+    {
+        std::string subcommand = argc < 3 ? "" : argv[2];
+        if (subcommand == "list")
+        {
+            std::cout << repository->sparse_checkout_patterns();
+            return 0;
+        }
+        if (subcommand != "set" && subcommand != "add" && subcommand != "disable")
+        {
+            std::cerr << "Usage: minigit sparse-checkout (set|add) <pattern>... | list | disable\n";
+            return 1;
+        }
+        return report(repository->sparse_checkout(subcommand, std::vector<std::string>(argv + 3, argv + argc)));
+    }
+    else if (command == "import")
+    {
+        // Reads the stream from stdin unless a file is given
+        if (argc < 3 || std::string(argv[2]) == "-")
+        {
+            return report(repository->import(std::cin));
+        }
+        std::ifstream source_file(argv[2], std::ios::binary);
+        if (!source_file.is_open())
+        {
+            std::cerr << "Error: Could not open import stream " << argv[2] << std::endl;
+            return 1;
+        }
+        return report(repository->import(source_file));
+    }
+
+    std::cerr << "Unknown command: " << command << std::endl;
+    return 1;
+}
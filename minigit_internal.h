@@ -0,0 +1,19 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "minigit.h"
+
+// Internals of libminigit that are not part of its API but that the benchmarks in bench/ measure
+// directly. Nothing here touches a repository: these work on object content already in memory.
+namespace minigit
+{
+
+// Parses the headers and message of a commit object's content into info
+void parse_commit(const std::string& content, CommitInfo& info);
+
+// Extracts the "<sha1> <path>" file entries of a commit object's content, keyed by path
+std::map<std::string, std::string> parse_commit_files(const std::string& content);
+
+} // namespace minigit
@@ -25,104 +25,101 @@ std::string sig2hex(void* sig) {
   return hex;
 }
 
-void* hash_bs(const void* input_bs, uint64_t input_size) {
-  auto* input = static_cast<const uint8_t*>(input_bs);
+// Runs the 80-round compression function over one 64-byte block.
+static void process_block(const uint8_t* block, uint32_t* h) {
+  std::array<uint32_t, 80> blocks{};
+  for (uint8_t bid = 0; bid < 16; bid++) {
+    blocks[bid] = (static_cast<uint32_t>(block[bid * 4]) << 24) |
+                  (static_cast<uint32_t>(block[bid * 4 + 1]) << 16) |
+                  (static_cast<uint32_t>(block[bid * 4 + 2]) << 8) |
+                  static_cast<uint32_t>(block[bid * 4 + 3]);
+  }
 
-  // Step 0: The initial 160-bit state
-  uint32_t h0 = 0x67452301, a = 0;
-  uint32_t h1 = 0xEFCDAB89, b = 0;
-  uint32_t h2 = 0x98BADCFE, c = 0;
-  uint32_t h3 = 0x10325476, d = 0;
-  uint32_t h4 = 0xC3D2E1F0, e = 0;
-
-  uint64_t padded_message_size = 0;
-  if (input_size % 64 < 56) {
-    padded_message_size = input_size + 64 - (input_size % 64);
-  } else {
-    padded_message_size = input_size + 128 - (input_size % 64);
+  for (uint8_t i = 16; i < 80; i++) {
+    blocks[i] =
+        leftRotate32bits(blocks[i - 3] ^ blocks[i - 8] ^
+                         blocks[i - 14] ^ blocks[i - 16],
+                         1);
+  }
+
+  uint32_t a = h[0];
+  uint32_t b = h[1];
+  uint32_t c = h[2];
+  uint32_t d = h[3];
+  uint32_t e = h[4];
+
+  for (uint8_t i = 0; i < 80; i++) {
+    uint32_t F = 0, g = 0;
+    if (i < 20) {
+      F = (b & c) | ((~b) & d);
+      g = 0x5A827999;
+    } else if (i < 40) {
+      F = b ^ c ^ d;
+      g = 0x6ED9EBA1;
+    } else if (i < 60) {
+      F = (b & c) | (b & d) | (c & d);
+      g = 0x8F1BBCDC;
+    } else {
+      F = b ^ c ^ d;
+      g = 0xCA62C1D6;
+    }
+
+    uint32_t temp = leftRotate32bits(a, 5) + F + e + g + blocks[i];
+    e = d;
+    d = c;
+    c = leftRotate32bits(b, 30);
+    b = a;
+    a = temp;
   }
 
-  std::vector<uint8_t> padded_message(padded_message_size);
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
 
-  std::copy(input, input + input_size, padded_message.begin());
+void digest(const void* input_bs, uint64_t input_size, uint8_t* out) {
+  auto* input = static_cast<const uint8_t*>(input_bs);
 
-  padded_message[input_size] = 1 << 7;
-  for (uint64_t i = input_size; i % 64 != 56; i++) {
-    if (i == input_size) {
-      continue;
-    }
-    padded_message[i] = 0;
+  // Step 0: The initial 160-bit state
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+  // Whole 64-byte blocks are hashed straight from the input; only the tail
+  // is copied so that padding never requires duplicating the full message.
+  uint64_t full_blocks = input_size / 64;
+  for (uint64_t chunk = 0; chunk < full_blocks; chunk++) {
+    process_block(input + chunk * 64, h);
   }
 
+  uint64_t tail_size = input_size % 64;
+  uint64_t padded_tail_size = tail_size < 56 ? 64 : 128;
+  std::array<uint8_t, 128> padded_tail{};
+  std::copy(input + full_blocks * 64, input + input_size, padded_tail.begin());
+  padded_tail[tail_size] = 1 << 7;
+
   uint64_t input_bitsize = input_size * 8;
   for (uint8_t i = 0; i < 8; i++) {
-    padded_message[padded_message_size - 8 + i] =
+    padded_tail[padded_tail_size - 8 + i] =
         (input_bitsize >> (56 - 8 * i)) & 0xFF;
   }
 
-  std::array<uint32_t, 80> blocks{};
-
-  for (uint64_t chunk = 0; chunk * 64 < padded_message_size; chunk++) {
-    for (uint8_t bid = 0; bid < 16; bid++) {
-      blocks[bid] = 0;
-      for (uint8_t cid = 0; cid < 4; cid++) {
-        blocks[bid] = (blocks[bid] << 8) +
-                      padded_message[chunk * 64 + bid * 4 + cid];
-      }
-    }
-
-    for (uint8_t i = 16; i < 80; i++) {
-      blocks[i] =
-          leftRotate32bits(blocks[i - 3] ^ blocks[i - 8] ^
-                           blocks[i - 14] ^ blocks[i - 16],
-                           1);
-    }
-
-    a = h0;
-    b = h1;
-    c = h2;
-    d = h3;
-    e = h4;
-
-    for (uint8_t i = 0; i < 80; i++) {
-      uint32_t F = 0, g = 0;
-      if (i < 20) {
-        F = (b & c) | ((~b) & d);
-        g = 0x5A827999;
-      } else if (i < 40) {
-        F = b ^ c ^ d;
-        g = 0x6ED9EBA1;
-      } else if (i < 60) {
-        F = (b & c) | (b & d) | (c & d);
-        g = 0x8F1BBCDC;
-      } else {
-        F = b ^ c ^ d;
-        g = 0xCA62C1D6;
-      }
-
-      uint32_t temp = leftRotate32bits(a, 5) + F + e + g + blocks[i];
-      e = d;
-      d = c;
-      c = leftRotate32bits(b, 30);
-      b = a;
-      a = temp;
-    }
-
-    h0 += a;
-    h1 += b;
-    h2 += c;
-    h3 += d;
-    h4 += e;
+  for (uint64_t offset = 0; offset < padded_tail_size; offset += 64) {
+    process_block(padded_tail.data() + offset, h);
   }
 
-  auto* sig = new uint8_t[20];
   for (uint8_t i = 0; i < 4; i++) {
-    sig[i] = (h0 >> (24 - 8 * i)) & 0xFF;
-    sig[i + 4] = (h1 >> (24 - 8 * i)) & 0xFF;
-    sig[i + 8] = (h2 >> (24 - 8 * i)) & 0xFF;
-    sig[i + 12] = (h3 >> (24 - 8 * i)) & 0xFF;
-    sig[i + 16] = (h4 >> (24 - 8 * i)) & 0xFF;
+    out[i] = (h[0] >> (24 - 8 * i)) & 0xFF;
+    out[i + 4] = (h[1] >> (24 - 8 * i)) & 0xFF;
+    out[i + 8] = (h[2] >> (24 - 8 * i)) & 0xFF;
+    out[i + 12] = (h[3] >> (24 - 8 * i)) & 0xFF;
+    out[i + 16] = (h[4] >> (24 - 8 * i)) & 0xFF;
   }
+}
+
+void* hash_bs(const void* input_bs, uint64_t input_size) {
+  auto* sig = new uint8_t[20];
+  digest(input_bs, input_size, sig);
   return sig;
 }
 
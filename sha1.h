@@ -12,7 +12,10 @@ uint32_t leftRotate32bits(uint32_t n, std::size_t rotate);
 // Transforms the 160-bit SHA-1 signature into a 40 char hex string.
 std::string sig2hex(void* sig);
 
-// The SHA-1 algorithm itself, taking in a bytestring.
+// The SHA-1 algorithm itself, writing the 20-byte digest of a bytestring to out.
+void digest(const void* input_bs, uint64_t input_size, uint8_t* out);
+
+// Same as digest(), returning a new[]-allocated 20-byte signature.
 void* hash_bs(const void* input_bs, uint64_t input_size);
 
 // Converts the string to bytestring and calls the main algorithm.
@@ -0,0 +1,182 @@
+#include "sha256.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define MINIGIT_SHA256_X86 1
+#endif
+
+namespace hashing::sha256 {
+
+namespace {
+
+alignas(16) const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t rotr(uint32_t n, int rotate) {
+  return (n >> rotate) | (n << (32 - rotate));
+}
+
+// Runs the 64-round compression function over each 64-byte block.
+void process_blocks_portable(uint32_t* h, const uint8_t* blocks, uint64_t count) {
+  for (uint64_t b = 0; b < count; b++) {
+    const uint8_t* block = blocks + b * 64;
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+      w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) |
+             (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+             (static_cast<uint32_t>(block[i * 4 + 2]) << 8) |
+             static_cast<uint32_t>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; i++) {
+      uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = h[0], b_ = h[1], c = h[2], d = h[3];
+    uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; i++) {
+      uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+      uint32_t ch = (e & f) ^ (~e & g);
+      uint32_t temp1 = hh + s1 + ch + K[i] + w[i];
+      uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+      uint32_t maj = (a & b_) ^ (a & c) ^ (b_ & c);
+      uint32_t temp2 = s0 + maj;
+      hh = g;
+      g = f;
+      f = e;
+      e = d + temp1;
+      d = c;
+      c = b_;
+      b_ = a;
+      a = temp1 + temp2;
+    }
+    h[0] += a;
+    h[1] += b_;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+  }
+}
+
+#ifdef MINIGIT_SHA256_X86
+
+// The same compression with the SHA-NI instructions. The state is kept as the
+// ABEF/CDGH register pair those instructions expect; each iteration of the
+// round loop does four rounds and, past the first sixteen words, extends the
+// message schedule by four words.
+__attribute__((target("sha,sse4.1,ssse3"))) void process_blocks_shani(
+    uint32_t* h, const uint8_t* blocks, uint64_t count) {
+  const __m128i byte_swap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&h[0])), 0xB1);
+  __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&h[4])), 0x1B);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);       // CDGH
+
+  for (uint64_t b = 0; b < count; b++) {
+    const uint8_t* block = blocks + b * 64;
+    __m128i abef_save = state0;
+    __m128i cdgh_save = state1;
+    __m128i w[4];
+    for (int i = 0; i < 16; i++) {
+      __m128i words;
+      if (i < 4) {
+        words = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16)), byte_swap);
+      } else {
+        // w[i & 3] still holds words i-4, and the others i-3, i-2 and i-1.
+        words = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+        words = _mm_add_epi32(words, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+        words = _mm_sha256msg2_epu32(words, w[(i + 3) & 3]);
+      }
+      w[i & 3] = words;
+      __m128i message =
+          _mm_add_epi32(words, _mm_load_si128(reinterpret_cast<const __m128i*>(&K[i * 4])));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+    }
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+  }
+
+  // Back from the ABEF/CDGH pair to the A..D, E..H word order.
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&h[0]), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&h[4]), state1);
+}
+
+bool cpu_has_sha_extensions() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) ||
+      !(ecx & bit_SSSE3)) {
+    return false;
+  }
+  return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+}
+
+#endif  // MINIGIT_SHA256_X86
+
+void process_blocks(uint32_t* h, const uint8_t* blocks, uint64_t count) {
+#ifdef MINIGIT_SHA256_X86
+  static const bool use_shani = cpu_has_sha_extensions();
+  if (use_shani) {
+    process_blocks_shani(h, blocks, count);
+    return;
+  }
+#endif
+  process_blocks_portable(h, blocks, count);
+}
+
+}  // namespace
+
+void digest(const void* input_bs, uint64_t input_size, uint8_t* out) {
+  uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  const auto* input = static_cast<const uint8_t*>(input_bs);
+
+  // Whole blocks are hashed straight from the input; only the tail and the
+  // padding are copied.
+  uint64_t full_blocks = input_size / 64;
+  process_blocks(h, input, full_blocks);
+
+  uint8_t tail[128] = {};
+  uint64_t remaining = input_size - full_blocks * 64;
+  std::memcpy(tail, input + full_blocks * 64, remaining);
+  tail[remaining] = 0x80;
+  uint64_t tail_size = remaining + 9 <= 64 ? 64 : 128;
+  uint64_t bit_length = input_size * 8;
+  for (int i = 0; i < 8; i++) {
+    tail[tail_size - 1 - i] = static_cast<uint8_t>(bit_length >> (8 * i));
+  }
+  process_blocks(h, tail, tail_size / 64);
+
+  for (int i = 0; i < 8; i++) {
+    out[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+    out[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+    out[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+    out[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+  }
+}
+
+}  // namespace hashing::sha256
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hashing::sha256 {
+
+// Writes the 32-byte SHA-256 digest of a bytestring to out. Uses the x86 SHA
+// extensions when the CPU has them and a portable implementation otherwise.
+void digest(const void* input_bs, uint64_t input_size, uint8_t* out);
+
+}  // namespace hashing::sha256
@@ -0,0 +1,138 @@
+#include "trace.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+namespace detail {
+
+bool enabled = false;
+std::atomic<uint64_t> counters[kCounterCount];
+
+}  // namespace detail
+
+namespace {
+
+const char* const kCounterNames[kCounterCount] = {
+    "objects_read", "objects_written", "bytes_hashed",
+    "files_stated", "cache_hits",      "cache_misses"};
+
+// Buffered events are appended to the trace file once this many are pending;
+// every region adds two (its own and a counter snapshot).
+constexpr size_t kFlushEvents = 8192;
+
+std::ofstream output;
+std::chrono::steady_clock::time_point trace_start;
+std::mutex events_mutex;
+std::vector<std::string> events;
+
+// Small sequential thread ids read better in the trace viewer than native ones.
+int thread_id() {
+  static std::atomic<int> next_id{1};
+  thread_local int id = next_id++;
+  return id;
+}
+
+int64_t microseconds_since_start(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(time - trace_start)
+      .count();
+}
+
+std::string escape(const std::string& text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", c);
+      escaped += code;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string counter_event(int64_t timestamp) {
+  std::string event = "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":" +
+                      std::to_string(::getpid()) +
+                      ",\"ts\":" + std::to_string(timestamp) + ",\"args\":{";
+  for (int c = 0; c < kCounterCount; c++) {
+    event += std::string(c == 0 ? "" : ",") + "\"" + kCounterNames[c] + "\":" +
+             std::to_string(detail::counters[c].load(std::memory_order_relaxed));
+  }
+  return event + "}}";
+}
+
+// Appends the buffered events to the trace file; events_mutex must be held.
+void flush_events() {
+  for (const std::string& event : events) {
+    output << event << ",\n";
+  }
+  events.clear();
+}
+
+}  // namespace
+
+void detail::record_region(const char* name, const std::string& label,
+                           std::chrono::steady_clock::time_point start) {
+  auto end = std::chrono::steady_clock::now();
+  int64_t start_us = microseconds_since_start(start);
+  std::string event = "{\"name\":\"" + escape(name) +
+                      "\",\"cat\":\"minigit\",\"ph\":\"X\",\"pid\":" +
+                      std::to_string(::getpid()) +
+                      ",\"tid\":" + std::to_string(thread_id()) +
+                      ",\"ts\":" + std::to_string(start_us) +
+                      ",\"dur\":" +
+                      std::to_string(microseconds_since_start(end) - start_us);
+  if (!label.empty()) {
+    event += ",\"args\":{\"detail\":\"" + escape(label) + "\"}";
+  }
+  event += "}";
+  std::string counters = counter_event(microseconds_since_start(end));
+  std::lock_guard<std::mutex> lock(events_mutex);
+  events.push_back(std::move(event));
+  events.push_back(std::move(counters));
+  if (events.size() >= kFlushEvents) {
+    flush_events();
+  }
+}
+
+void init_from_environment() {
+  const char* path = std::getenv("MINIGIT_TRACE");
+  if (path == nullptr || *path == '\0') {
+    return;
+  }
+  // The file is opened now, before a command can change directory, and
+  // tracing stays off when it cannot be created.
+  output.open(path, std::ios::trunc);
+  if (!output.is_open()) {
+    return;
+  }
+  output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  events.reserve(kFlushEvents);
+  trace_start = std::chrono::steady_clock::now();
+  detail::enabled = true;
+  std::atexit(finish);
+}
+
+void finish() {
+  if (!detail::enabled) {
+    return;
+  }
+  detail::enabled = false;
+  std::lock_guard<std::mutex> lock(events_mutex);
+  flush_events();
+  output << counter_event(microseconds_since_start(std::chrono::steady_clock::now()))
+         << "\n]}\n";
+  output.close();
+}
+
+}  // namespace trace
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Opt-in performance tracing in the Chrome trace-event format.
+//
+// Setting MINIGIT_TRACE=<file> makes minigit write a JSON trace of nested
+// region timings and counter snapshots to <file> when it exits; the file loads
+// in chrome://tracing or Perfetto. Events are buffered and appended to the
+// file in blocks, so long commands hold at most one block in memory. Without
+// the variable every hook below is a single branch on a flag that is never set.
+namespace trace {
+
+enum Counter {
+  kObjectsRead,
+  kObjectsWritten,
+  kBytesHashed,
+  kFilesStated,
+  kCacheHits,    // Lookups answered by an in-memory cache (commit graph, import tips).
+  kCacheMisses,  // Lookups that had to fall back to reading objects.
+  kCounterCount
+};
+
+namespace detail {
+extern bool enabled;
+extern std::atomic<uint64_t> counters[kCounterCount];
+void record_region(const char* name, const std::string& label,
+                   std::chrono::steady_clock::time_point start);
+}  // namespace detail
+
+// Reads MINIGIT_TRACE; call once at startup before any threads are created.
+void init_from_environment();
+
+// Writes the remaining events and closes the trace; also registered to run at
+// exit.
+void finish();
+
+inline bool enabled() { return detail::enabled; }
+
+inline void count(Counter counter, uint64_t amount = 1) {
+  if (detail::enabled) {
+    detail::counters[counter].fetch_add(amount, std::memory_order_relaxed);
+  }
+}
+
+// Records a region whose start was taken by the caller, for phases that are
+// not a single scope.
+inline void region_ended(const char* name, std::chrono::steady_clock::time_point start,
+                         const std::string& label = std::string()) {
+  if (detail::enabled) {
+    detail::record_region(name, label, start);
+  }
+}
+
+// Times the enclosing scope as one complete ("X") event. Regions nest by
+// scope, and each one also snapshots the counters when it ends. The name must
+// outlive the region.
+class Region {
+ public:
+  explicit Region(const char* name) : name_(name) {
+    if (detail::enabled) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  Region(const char* name, const std::string& label) : Region(name) {
+    if (detail::enabled) {
+      label_ = label;
+    }
+  }
+
+  // Labels the region "<count> <unit>", e.g. "1200 files". The label is only
+  // formatted when tracing is on, so hot paths can pass their sizes freely.
+  Region(const char* name, uint64_t count, const char* unit) : Region(name) {
+    if (detail::enabled) {
+      label_ = std::to_string(count) + " " + unit;
+    }
+  }
+
+  ~Region() {
+    if (detail::enabled) {
+      detail::record_region(name_, label_, start_);
+    }
+  }
+
+  Region(const Region&) = delete;
+  Region& operator=(const Region&) = delete;
+
+ private:
+  const char* name_;
+  std::string label_;  // Shown as args.detail, e.g. the branch or path involved.
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace trace